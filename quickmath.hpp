@@ -11,13 +11,21 @@
  * all the types and functions provided by this library are under the the "qm" namespace
  * 
  * if you wish not to use SSE3 intrinsics (if they are not supported for example),
- * change the macro on line 101 to "#define QM_USE_SSE 0"
+ * change the macro on line 317 to "#define QM_USE_SSE 0"
  * 
- * if you wish not to include <iostream> in your project, simply change the macro on line 109
+ * if you wish to use AVX intrinsics for the double precision types, change the macro on line 326
+ * to "#define QM_USE_AVX 1" and compile every file that includes this one with AVX enabled,
+ * otherwise their functions use SSE2 or scalar code
+ * 
+ * if you wish to use SSE4.1 intrinsics for the integer vector types, change the macro on line 338
+ * to "#define QM_USE_SSE4_1 1" and compile every file that includes this one with SSE4.1 enabled,
+ * otherwise they use SSE2 sequences
+ * 
+ * if you wish not to include <iostream> in your project, simply change the macro on line 349
  * to "#define QM_INCLUDE_IOSTREAM 0" and any iostream related functions will not be compiled
  * 
  * to disable the need to link with the C runtime library, change the macros beginning
- * on line 116 and the #include on line 114 to the appropirate functions/files
+ * on line 359 and the #includes beginning on line 356 to the appropirate functions/files
  * 
  * ------------------------------------------------------------------------
  * 
@@ -32,6 +40,7 @@
  * float      distance                   (vecn v1, vecn v2);
  * vecn       min                        (vecn v1, vecn v2);
  * vecn       max                        (vecn v1, vecn v2);
+ * vecn       lerp                       (vecn v1, vecn v2, float a);
  * 
  * matn       matn_identity              ();
  * matn       transpose                  (matn m);
@@ -58,9 +67,203 @@
  * quaternion conjugate                  (quaternion q);
  * quaternion inverse                    (quaternion q);
  * quaternion slerp                      (quaternion q1, quaternion q2, float a);
+ * quaternion nlerp                      (quaternion q1, quaternion q2, float a);
+ * quaternion log                        (quaternion q);
+ * quaternion exp                        (quaternion q);
+ * quaternion squad                      (quaternion q1, quaternion q2, quaternion s1, quaternion s2, float a);
+ * quaternion squad_control              (quaternion q0, quaternion q1, quaternion q2);
+ * quaternion catmull_rom                (quaternion q0, quaternion q1, quaternion q2, quaternion q3, float a);
  * quaternion quaternion_from_axis_angle (vec3 axis, float angle);
  * quaternion quaternion_from_euler      (vec3 angles);
  * mat4       quaternion_to_mat4         (quaternion q);
+ * quaternion quaternion_from_mat3       (mat3 m);
+ * 
+ * mat4       compose                    (vec3 t, quaternion r, vec3 s);
+ * void       compose                    (vec3* t, quaternion* r, vec3* s, mat4* out, size_t n);
+ * void       compose                    (vec3* t, quaternion* r, vec3* s, uint32_t* indices, mat4* out, size_t n);
+ * void       compose_gather             (vec3* t, quaternion* r, vec3* s, uint32_t* indices, size_t n, void* out, compose_store store);
+ * mat4       mult_affine                (mat4 m1, mat4 m2);
+ * void       build_instance_matrices    (vec3* pos, quaternion* rot, vec3* scl, uint32_t* visible, size_t n, mat4* out);
+ * void       build_instance_rows        (vec3* pos, quaternion* rot, vec3* scl, uint32_t* visible, size_t n, vec4* out);
+ * 
+ * void       skin_lbs                   (mat4* palette, vec3* pos, vec3* nrm, uint8_t* joints, float* weights,
+ *                                        int influences, vec3* outPos, vec3* outNrm, size_t n);
+ * void       skin_lbs                   (mat4* palette, vec3* pos, vec3* nrm, uint16_t* joints, float* weights,
+ *                                        int influences, vec3* outPos, vec3* outNrm, size_t n);
+ * 
+ * vec3       sample_track               (vec3_track track, float t, size_t* cursor);
+ * quaternion sample_track               (quaternion_track track, float t, size_t* cursor, bool useSlerp = false);
+ * void       sample_tracks              (vec3_track* tracks, size_t* cursors, float t, vec3* out, size_t n);
+ * void       sample_tracks              (quaternion_track* tracks, size_t* cursors, float t, quaternion* out, size_t n,
+ *                                        bool useSlerp = false);
+ * void       blend_poses                (quaternion** poses, float* weights, size_t numPoses, quaternion* out, size_t boneCount);
+ * void       blend_poses                (vec3** poses, float* weights, size_t numPoses, vec3* out, size_t boneCount);
+ * void       blend_poses_accurate       (quaternion** poses, float* weights, size_t numPoses, quaternion* out, size_t boneCount);
+ * quaternion average                    (quaternion* q, float* weights, size_t n);
+ * void       align_keys                 (quaternion* keys, size_t n);
+ * void       squad_controls             (quaternion* keys, quaternion* controls, size_t n);
+ * void       sample_squad               (float* times, quaternion* keys, quaternion* controls, size_t numKeys,
+ *                                        float* ts, quaternion* out, size_t n);
+ * 
+ * vecn       bezier                     (vecn p0, vecn p1, vecn p2, vecn p3, float t);
+ * vecn       bezier_derivative          (vecn p0, vecn p1, vecn p2, vecn p3, float t);
+ * vecn       hermite                    (vecn p0, vecn m0, vecn p1, vecn m1, float t);
+ * vecn       hermite_derivative         (vecn p0, vecn m0, vecn p1, vecn m1, float t);
+ * vecn       catmull_rom                (vecn p0, vecn p1, vecn p2, vecn p3, float t);
+ * vecn       catmull_rom_derivative     (vecn p0, vecn p1, vecn p2, vecn p3, float t);
+ * vec4       curve_weights              (curve_type type, float t, bool derivative = false);
+ * 
+ * int        mask_lt                    (vec4 v1, vec4 v2);
+ * int        mask_le                    (vec4 v1, vec4 v2);
+ * vec4       select                     (int mask, vec4 v1, vec4 v2);
+ * vec4       abs                        (vec4 v);
+ * vec4       sqrt                       (vec4 v);
+ * vec4       load4                      (float* p);
+ * void       store4                     (float* p, vec4 v);
+ * size_t     append_lanes               (int mask, size_t base, uint32_t* out, size_t count);
+ * int        intersect                  (ray_packet rays, aabb box, vec4 tMax, vec4* tNear = nullptr);
+ * int        intersect                  (vec3 origin, vec3 invDir, aabb4 boxes, float tMax, vec4* tNear = nullptr);
+ * int        intersect                  (ray_packet rays, aabb* boxes, size_t n, vec4* tMax, int* hitIndex);
+ * void       intersect                  (ray_packet rays, aabb* boxes, size_t n, vec4 tMax, int* masks);
+ * bool       intersect                  (vec3 origin, vec3 dir, vec3 v0, vec3 v1, vec3 v2, float tMax,
+ *                                        float* t, float* u, float* v);
+ * int        intersect                  (vec3 origin, vec3 dir, triangle4 tris, float tMax, vec4* t, vec4* u, vec4* v);
+ * int        intersect                  (ray_packet rays, vec3 v0, vec3 v1, vec3 v2, vec4 tMax, vec4* t, vec4* u, vec4* v);
+ * int        intersect                  (vec3 origin, vec3 dir, triangle4* tris, size_t n, float* tMax, float* u, float* v);
+ * 
+ * aabb       merge                      (aabb b1, aabb b2);
+ * aabb       merge                      (aabb b, vec3 p);
+ * float      surface_area               (aabb b);
+ * bool       overlap                    (aabb b1, aabb b2);
+ * float      distance_squared           (aabb b, vec3 p);
+ * bool       intersect                  (vec3 origin, vec3 invDir, aabb box, float tMax, float* tNear = nullptr);
+ * aabb       lane                       (aabb4 b, size_t i);
+ * void       set_lane                   (aabb4& b, size_t i, aabb val);
+ * vec3       closest_point_on_triangle  (vec3 p, vec3 a, vec3 b, vec3 c);
+ * 
+ * float      distance                   (plane p, vec3 point);
+ * vec3       closest_point              (plane/sphere/aabb/segment/capsule/obb shape, vec3 point);
+ * float      closest_points             (segment s1, segment s2, vec3* c1, vec3* c2);
+ * bool       overlap                    (sphere s1, sphere s2);
+ * bool       overlap                    (sphere s, aabb b);
+ * bool       overlap                    (plane p, sphere s);
+ * bool       overlap                    (sphere s, capsule c);
+ * bool       overlap                    (capsule c1, capsule c2);
+ * size_t     overlap                    (sphere s, sphere_array spheres, size_t n, uint32_t* out);
+ * size_t     overlap                    (sphere s, aabb_array boxes, size_t n, uint32_t* out);
+ * size_t     overlap                    (aabb b, sphere_array spheres, size_t n, uint32_t* out);
+ * size_t     overlap                    (aabb b, aabb_array boxes, size_t n, uint32_t* out);
+ * size_t     overlap                    (plane p, sphere_array spheres, size_t n, uint32_t* out);
+ * void       distance                   (plane p, vec3_array points, size_t n, float* out);
+ * void       closest_point              (plane/sphere/aabb/segment shape, vec3_array points, size_t n,
+ *                                        vec3_out_array out);
+ * bool       overlap                    (obb a, obb b);
+ * size_t     overlap                    (obb a, obb* boxes, size_t n, uint32_t* out);
+ * 
+ * vec3       support                    (vec3/sphere/capsule/aabb/obb/convex_hull shape, vec3 dir);
+ * bool       gjk<A, B>                  (A a, B b, gjk_result* result = nullptr);
+ * bool       epa<A, B>                  (A a, B b, gjk_result* result);
+ * 
+ * uint32_t   morton_spread              (uint32_t x);
+ * uint64_t   morton_spread              (uint64_t x);
+ * void       morton_encode              (vec3* points, aabb bounds, uint32_t* out, size_t n);
+ * void       morton_encode              (vec3* points, aabb bounds, uint64_t* out, size_t n);
+ * void       radix_sort<T>              (T* keys, size_t n, uint32_t* perm);
+ * void       reorder<T>                 (T* in, uint32_t* perm, size_t n, T* out);
+ * 
+ * aabb       compute_aabb               (vec3* points, size_t n);
+ * vec3       compute_centroid           (vec3* points, size_t n);
+ * size_t     furthest_point             (vec3* points, size_t n, vec3 p);
+ * void       grow_sphere                (sphere* s, vec3* points, size_t n, size_t start);
+ * sphere     compute_bounding_sphere    (vec3* points, size_t n, int refinements = 8);
+ * 
+ * void       eigen_symmetric            (mat3 m, vec3* values, mat3* vectors);
+ * void       eigen_symmetric            (mat3* m, size_t n, vec3* values, mat3* vectors);
+ * mat3       compute_covariance         (vec3* points, size_t n, vec3* mean = nullptr);
+ * void       pca                        (vec3* points, size_t n, vec3* mean, mat3* axes, vec3* variances);
+ * obb        fit_obb                    (vec3* points, size_t n);
+ * 
+ * void       svd                        (mat3 m, mat3* u, vec3* sigma, mat3* v);
+ * void       svd                        (mat3* m, size_t n, mat3* u, vec3* sigma, mat3* v);
+ * mat3       polar_decomposition        (mat3 m, mat3* stretch = nullptr);
+ * void       polar_decomposition        (mat3* m, size_t n, mat3* rotations);
+ * 
+ * mat3       kabsch                     (vec3* source, vec3* target, size_t n, vec3* translation = nullptr);
+ * float      icp                        (vec3* source, size_t n, bvh target, mat3* rotation, vec3* translation,
+ *                                        int maxIterations = 32, float maxDistance = INFINITY,
+ *                                        float tolerance = 1e-6f);
+ * 
+ * mat<N,N,T> mat_identity<N, T>         ();
+ * qua<T>     qua_identity<T>            ();
+ * 
+ * dmat4      dmat4_identity             ();
+ * void       rebase                     (dvec3* positions, dvec3 origin, vec3* out, size_t n);
+ * mat4       rebase                     (dmat4 m, dvec3 origin);
+ * 
+ * ivecn      ifloor                     (vecn v);
+ * ivecn      iround                     (vecn v);
+ * ivecn      itrunc                     (vecn v);
+ * vecn       to_float                   (ivecn v);
+ * int        mask_eq                    (ivec4/uvec4 v1, ivec4/uvec4 v2);
+ * int        mask_lt                    (ivec4/uvec4 v1, ivec4/uvec4 v2);
+ * int        mask_le                    (ivec4/uvec4 v1, ivec4/uvec4 v2);
+ * ivec4      select                     (int mask, ivec4 v1, ivec4 v2);
+ * 
+ * mat2       mat2_identity              ();
+ * mat2       transpose                  (mat2 m);
+ * mat2       inverse                    (mat2 m);
+ * mat2       top_left                   (mat3 m);
+ * mat2x3     mat2x3_identity            ();
+ * mat2x3     compose                    (vec2 t, float angle, vec2 s);
+ * mat2x3     inverse                    (mat2x3 m);
+ * mat3       to_mat3                    (mat2x3 m);
+ * void       transform_points           (mat2x3 m, vec2* points, size_t n, vec2* out);
+ * void       sprite_corners             (vec2* positions, float* angles, vec2* scales, vec2* sizes, size_t n,
+ *                                        vec2* out);
+ * 
+ * the following types are defined:
+ * 
+ * vec<N, T>                -> N-dimensional vector of T, vec2/vec3/vec4 are its float specializations
+ * mat<R, C, T>             -> column-major matrix of T with R rows and C columns, mat3/mat4 are its
+ *                             float specializations
+ * qua<T>                   -> quaternion of T, quaternion is its float specialization
+ * dvec2/dvec3/dvec4        -> double precision vectors, dvec4 is packed into an AVX register
+ * dmat3/dmat4              -> double precision matrices, dmat4 columns are packed into AVX registers
+ * dquaternion              -> double precision quaternion, packed into an AVX register
+ * ivec2/ivec3/ivec4        -> signed integer vectors, ivec4 is packed into an SSE register
+ * uvec2/uvec3/uvec4        -> unsigned integer vectors, uvec4 is packed into an SSE register
+ * mat2                     -> 2x2 float matrix, packed into an SSE register
+ * mat2x3                   -> affine 2D transform, a 2x2 linear part and a translation column
+ * vec3x4                   -> 4 vec3s stored as SoA (x, y and z vec4s), with +, -, *, dot, cross,
+ *                             min and max defined
+ * aabb                     -> axis-aligned bounding box (min, max)
+ * aabb4                    -> 4 aabbs stored as SoA
+ * ray_packet               -> 4 rays stored as SoA, with precomputed reciprocal directions
+ * triangle4                -> 4 triangles stored as SoA (first vertex and two edges)
+ * plane                    -> normal and distance, dot(normal, p) + d = 0
+ * sphere                   -> center and radius
+ * segment                  -> two endpoints
+ * capsule                  -> segment endpoints and radius
+ * obb                      -> oriented bounding box (center, mat3 of axes, half-extents)
+ * vec3_array               -> non-owning read-only view of SoA x, y and z float arrays
+ * vec3_out_array           -> non-owning writable view of SoA x, y and z float arrays
+ * sphere_array             -> non-owning read-only view of SoA sphere centers and radii
+ * aabb_array               -> non-owning read-only view of SoA box bounds
+ * convex_hull              -> non-owning view of a vertex array, used as a convex shape
+ * gjk_result               -> intersection, distance, penetration depth, normal and witness points
+ * transform_hierarchy      -> local TRS transforms stored parent-first in contiguous arrays,
+ *                             computes world mat4s only for dirty subtrees in update(),
+ *                             supports add/remove/reparent with incremental re-sorting
+ * vec3_track               -> keyframe times and vec3 keys (non-owning)
+ * quaternion_track         -> keyframe times and quaternion keys (non-owning)
+ * spline2/spline3/spline4  -> piecewise bezier/hermite/catmull-rom curves with batch evaluation
+ *                             and an arc-length table for sampling by distance
+ * camera                   -> lazily cached view/projection/view-projection matrices, their
+ *                             inverses and frustum planes
+ * bvh                      -> 4-wide bounding volume hierarchy over boxes or triangles, built with
+ *                             binned SAH, with refit and ray, box overlap and nearest primitive queries
+ * spatial_grid             -> hashed uniform grid over points, counting-sorted into SoA buckets,
+ *                             with SIMD-filtered radius queries
  * 
  * the following operators are defined:
  * (vecn means a vector of dimension, 2, 3, or 4, named vec2, vec3, and vec4)
@@ -91,6 +294,19 @@
  * float / quaternion       -> quaternion
  * quaternion == quaternion -> bool
  * quaternion != quaternion -> bool
+ * 
+ * mat2 + mat2              -> mat2 (also - and *)
+ * mat2 * vec2              -> vec2
+ * mat2x3 * mat2x3          -> mat2x3
+ * mat2x3 * vec2            -> vec2 (transforms a point)
+ * 
+ * ivecn & ivecn            -> ivecn (also |, ^ and the same for uvecn)
+ * ivecn << int             -> ivecn (>> is arithmetic for ivecn and logical for uvecn)
+ * 
+ * (the operators above except float / quaternion, along with dot, cross, length, normalize,
+ * distance, min, max, lerp and transpose, are also defined generically for vec<N, T>,
+ * mat<R, C, T> and qua<T>, as are conjugate and inverse for qua<T>; the hand-written float
+ * versions take precedence, and matrix inverse is only defined for mat2, mat2x3, mat3 and mat4)
  */
 
 #ifndef QM_MATH_H
@@ -104,6 +320,30 @@
 	#include <pmmintrin.h>
 #endif
 
+//if you wish to use AVX SIMD intrinsics for the double precision types, simply change the
+//#define to 1, this requires QM_USE_SSE and every file including this one being compiled with AVX
+//enabled (-mavx or /arch:AVX), since it changes the layout of the double precision types
+#define QM_USE_AVX 0
+#if QM_USE_AVX
+	#if !QM_USE_SSE || !defined(__AVX__)
+		#error "QM_USE_AVX requires QM_USE_SSE and a compiler targeting AVX"
+	#endif
+
+	#include <immintrin.h>
+#endif
+
+//if you wish to use SSE4.1 SIMD intrinsics for the integer vector types, simply change the
+//#define to 1, this requires QM_USE_SSE and every file including this one being compiled with
+//SSE4.1 enabled (-msse4.1 or /arch:AVX), otherwise they use SSE2 sequences
+#define QM_USE_SSE4_1 0
+#if QM_USE_SSE4_1
+	#if !QM_USE_SSE || !(defined(__SSE4_1__) || defined(__AVX__))
+		#error "QM_USE_SSE4_1 requires QM_USE_SSE and a compiler targeting SSE4.1"
+	#endif
+
+	#include <smmintrin.h>
+#endif
+
 //if you wish NOT to include iostream, simply change the
 //#define to 0
 #define QM_INCLUDE_IOSTREAM 1
@@ -114,12 +354,25 @@
 //if you wish to not use any of the CRT functions, you must #define your
 //own versions of the below functions and #include the appropriate header
 #include <math.h>
-
-#define QM_SQRTF sqrtf
-#define QM_SINF  sinf
-#define QM_COSF  cosf
-#define QM_TANF  tanf
-#define QM_ACOSF acosf
+#include <stdlib.h>
+
+#define QM_SQRTF   sqrtf
+#define QM_SINF    sinf
+#define QM_COSF    cosf
+#define QM_TANF    tanf
+#define QM_ACOSF   acosf
+#define QM_ATAN2F  atan2f
+#define QM_FLOORF  floorf
+#define QM_RINTF   rintf
+#define QM_FABSF   fabsf
+#define QM_SQRT    ::sqrt //qualified, qm::sqrt(vec4) would hide it
+
+//QM_MALLOC and QM_REALLOC must return memory aligned to at least 16 bytes (32 with QM_USE_AVX)
+#define QM_MALLOC  malloc
+#define QM_REALLOC realloc
+#define QM_FREE    free
+
+#include <stdint.h>
 
 namespace qm
 {
@@ -127,33 +380,171 @@ namespace qm
 //----------------------------------------------------------------------//
 //STRUCT DEFINITIONS:
 
+//the vector, matrix and quaternion types are templates over their dimensions and scalar type
+//the float specializations are hand-written with SIMD members and keep their familiar names,
+//any other scalar type gets the generic definitions and the generic functions at the end of this file
+
+template<int N, typename T> union vec;
+template<int R, int C, typename T> union mat;
+template<typename T> union qua;
+
+typedef vec<2, float>     vec2;
+typedef vec<3, float>     vec3;
+typedef vec<4, float>     vec4;
+typedef mat<2, 2, float>  mat2;
+typedef mat<2, 3, float>  mat2x3;
+typedef mat<3, 3, float>  mat3;
+typedef mat<4, 4, float>  mat4;
+typedef qua<float>        quaternion;
+
+typedef vec<2, double>    dvec2;
+typedef vec<3, double>    dvec3;
+typedef vec<4, double>    dvec4;
+typedef mat<3, 3, double> dmat3;
+typedef mat<4, 4, double> dmat4;
+typedef qua<double>       dquaternion;
+
+typedef vec<2, int32_t>   ivec2;
+typedef vec<3, int32_t>   ivec3;
+typedef vec<4, int32_t>   ivec4;
+typedef vec<2, uint32_t>  uvec2;
+typedef vec<3, uint32_t>  uvec3;
+typedef vec<4, uint32_t>  uvec4;
+
+//-----------------------------//
+//generic definitions:
+
+//an N-dimensional vector of T
+template<int N, typename T>
+union vec
+{
+	T v[N] = {};
+
+	vec() {};
+	vec(T _val) { for(int i = 0; i < N; i++) v[i] = _val; };
+
+	template<typename U>
+	explicit vec(const vec<N, U>& _v) { for(int i = 0; i < N; i++) v[i] = (T)_v.v[i]; };
+
+	inline T& operator[](size_t i) { return v[i]; };
+};
+
+template<typename T>
+union vec<2, T>
+{
+	T v[2] = {};
+	struct{ T x, y; };
+
+	vec() {};
+	vec(T _x, T _y) { x = _x, y = _y; };
+	vec(T _val) { x = _val, y = _val; };
+
+	template<typename U>
+	explicit vec(const vec<2, U>& _v) { x = (T)_v.x, y = (T)_v.y; };
+
+	inline T& operator[](size_t i) { return v[i]; };
+};
+
+template<typename T>
+union vec<3, T>
+{
+	T v[3] = {};
+	struct{ T x, y, z; };
+
+	vec() {};
+	vec(T _x, T _y, T _z) { x = _x, y = _y, z = _z; };
+	vec(vec<2, T> _xy, T _z) { x = _xy.x, y = _xy.y, z = _z; };
+	vec(T _val) { x = _val, y = _val, z = _val; };
+
+	template<typename U>
+	explicit vec(const vec<3, U>& _v) { x = (T)_v.x, y = (T)_v.y, z = (T)_v.z; };
+
+	inline T& operator[](size_t i) { return v[i]; };
+};
+
+template<typename T>
+union vec<4, T>
+{
+	T v[4] = {};
+	struct{ T x, y, z, w; };
+
+	vec() {};
+	vec(T _x, T _y, T _z, T _w) { x = _x, y = _y, z = _z, w = _w; };
+	vec(vec<3, T> _xyz, T _w) { x = _xyz.x, y = _xyz.y, z = _xyz.z, w = _w; };
+	vec(T _val) { x = _val, y = _val, z = _val, w = _val; };
+
+	template<typename U>
+	explicit vec(const vec<4, U>& _v) { x = (T)_v.x, y = (T)_v.y, z = (T)_v.z, w = (T)_v.w; };
+
+	inline T& operator[](size_t i) { return v[i]; };
+};
+
+//a column-major matrix of T with R rows and C columns
+template<int R, int C, typename T>
+union mat
+{
+	T m[C][R] = {};
+	vec<R, T> v[C];
+
+	mat() {};
+
+	inline vec<R, T>& operator[](size_t i) { return v[i]; };
+};
+
+template<typename T>
+union qua
+{
+	T q[4] = {};
+	struct{ T x, y, z, w; };
+
+	qua() {};
+	qua(T _x, T _y, T _z, T _w) { x = _x, y = _y, z = _z, w = _w; };
+	qua(vec<3, T> _xyz, T _w) { x = _xyz.x, y = _xyz.y, z = _xyz.z, w = _w; };
+
+	template<typename U>
+	explicit qua(const qua<U>& _q) { x = (T)_q.x, y = (T)_q.y, z = (T)_q.z, w = (T)_q.w; };
+
+	inline T operator[](size_t i) { return q[i]; };
+};
+
+//-----------------------------//
+//float specializations:
+
 //a 2-dimensional vector of floats
-union vec2
+template<>
+union vec<2, float>
 {
 	float v[2] = {};
 	struct{ float x, y; };
 	struct{ float w, h; };
 
-	vec2() {};
-	vec2(float _x, float _y) { x = _x, y = _y; };
-	vec2(float _val) { x = _val, y = _val; };
+	vec() {};
+	vec(float _x, float _y) { x = _x, y = _y; };
+	vec(float _val) { x = _val, y = _val; };
+
+	template<typename U>
+	explicit vec(const vec<2, U>& _v) { x = (float)_v.x, y = (float)_v.y; };
 
 	inline float& operator[](size_t i) { return v[i]; };
 };
 
 //a 3-dimensional vector of floats
-union vec3
+template<>
+union vec<3, float>
 {
 	float v[3] = {};
 	struct{ float x, y, z; };
 	struct{ float w, h, d; };
 	struct{ float r, g, b; };
 
-	vec3() {};
-	vec3(float _x, float _y, float _z) { x = _x, y = _y, z = _z; };
-	vec3(vec2 _xy, float _z) { x = _xy.x, y = _xy.y, z = _z; };
-	vec3(float _x, vec3 _yz) { x = _x, y = _yz.x, z = _yz.y; };
-	vec3(float _val) { x = _val, y = _val, z = _val; };
+	vec() {};
+	vec(float _x, float _y, float _z) { x = _x, y = _y, z = _z; };
+	vec(vec2 _xy, float _z) { x = _xy.x, y = _xy.y, z = _z; };
+	vec(float _x, vec3 _yz) { x = _x, y = _yz.x, z = _yz.y; };
+	vec(float _val) { x = _val, y = _val, z = _val; };
+
+	template<typename U>
+	explicit vec(const vec<3, U>& _v) { x = (float)_v.x, y = (float)_v.y, z = (float)_v.z; };
 
 	inline float& operator[](size_t i) { return v[i]; };
 
@@ -163,7 +554,8 @@ union vec3
 };
 
 //a 4-dimensional vector of floats
-union vec4
+template<>
+union vec<4, float>
 {
 	float v[4] = {};
 	struct{ float x, y, z, w; };
@@ -175,12 +567,15 @@ union vec4
 
 	#endif
 
-	vec4() {};
-	vec4(float _x, float _y, float _z, float _w) { x = _x, y = _y, z = _z, w = _w; };
-	vec4(vec3 _xyz, float _w) { x = _xyz.x, y = _xyz.y, z = _xyz.z, w = _w; };
-	vec4(float _x, vec3 _yzw) { x = _x, y = _yzw.x, z = _yzw.y, w = _yzw.z; };
-	vec4(vec2 _xy, vec2 _zw) { x = _xy.x, y = _xy.y, z = _zw.x, w = _zw.y; };
-	vec4(float _val) { x = _val, y = _val, z = _val, w = _val; };
+	vec() {};
+	vec(float _x, float _y, float _z, float _w) { x = _x, y = _y, z = _z, w = _w; };
+	vec(vec3 _xyz, float _w) { x = _xyz.x, y = _xyz.y, z = _xyz.z, w = _w; };
+	vec(float _x, vec3 _yzw) { x = _x, y = _yzw.x, z = _yzw.y, w = _yzw.z; };
+	vec(vec2 _xy, vec2 _zw) { x = _xy.x, y = _xy.y, z = _zw.x, w = _zw.y; };
+	vec(float _val) { x = _val, y = _val, z = _val, w = _val; };
+
+	template<typename U>
+	explicit vec(const vec<4, U>& _v) { x = (float)_v.x, y = (float)_v.y, z = (float)_v.z, w = (float)_v.w; };
 
 	inline float& operator[](size_t i) { return v[i]; };
 
@@ -200,17 +595,36 @@ union vec4
 //-----------------------------//
 //matrices are column-major
 
-union mat3
+template<>
+union mat<2, 2, float>
+{
+	float m[2][2] = {};
+	vec2 v[2];
+
+	#if QM_USE_SSE
+
+	__m128 packed; //both columns
+
+	#endif
+
+	mat() {};
+
+	inline vec2& operator[](size_t i) { return v[i]; };
+};
+
+template<>
+union mat<3, 3, float>
 {
 	float m[3][3] = {};
 	vec3 v[3];
 
-	mat3() {};
+	mat() {};
 
 	inline vec3& operator[](size_t i) { return v[i]; };
 };
 
-union mat4
+template<>
+union mat<4, 4, float>
 {
 	float m[4][4] = {};
 	vec4 v[4];
@@ -221,14 +635,15 @@ union mat4
 
 	#endif
 
-	mat4() {};
+	mat() {};
 
 	inline vec4& operator[](size_t i) { return v[i]; };
 };
 
 //-----------------------------//
 
-union quaternion
+template<>
+union qua<float>
 {
 	float q[4] = {};
 	struct{ float x, y, z, w; };
@@ -239,15 +654,306 @@ union quaternion
 
 	#endif
 
-	quaternion() {};
-	quaternion(float _x, float _y, float _z, float _w) { x = _x, y = _y, z = _z, w = _w; };
-	quaternion(vec3 _xyz, float _w) { x = _xyz.x, y = _xyz.y, z = _xyz.z, w = _w; };
-	quaternion(float _x, vec3 _yzw) { x = _x, y = _yzw.x, z = _yzw.y, w = _yzw.z; };
-	quaternion(vec2 _xy, vec2 _zw) { x = _xy.x, y = _xy.y, z = _zw.x, w = _zw.y; };
+	qua() {};
+	qua(float _x, float _y, float _z, float _w) { x = _x, y = _y, z = _z, w = _w; };
+	qua(vec3 _xyz, float _w) { x = _xyz.x, y = _xyz.y, z = _xyz.z, w = _w; };
+	qua(float _x, vec3 _yzw) { x = _x, y = _yzw.x, z = _yzw.y, w = _yzw.z; };
+	qua(vec2 _xy, vec2 _zw) { x = _xy.x, y = _xy.y, z = _zw.x, w = _zw.y; };
+
+	template<typename U>
+	explicit qua(const qua<U>& _q) { x = (float)_q.x, y = (float)_q.y, z = (float)_q.z, w = (float)_q.w; };
 
 	inline float operator[](size_t i) { return q[i]; };
 };
 
+//-----------------------------//
+//double specializations, packed into AVX registers when available:
+
+//a 4-dimensional vector of doubles
+template<>
+union vec<4, double>
+{
+	double v[4] = {};
+	struct{ double x, y, z, w; };
+
+	#if QM_USE_AVX
+
+	__m256d packed;
+
+	#endif
+
+	vec() {};
+	vec(double _x, double _y, double _z, double _w) { x = _x, y = _y, z = _z, w = _w; };
+	vec(dvec3 _xyz, double _w) { x = _xyz.x, y = _xyz.y, z = _xyz.z, w = _w; };
+	vec(double _val) { x = _val, y = _val, z = _val, w = _val; };
+
+	template<typename U>
+	explicit vec(const vec<4, U>& _v) { x = (double)_v.x, y = (double)_v.y, z = (double)_v.z, w = (double)_v.w; };
+
+	inline double& operator[](size_t i) { return v[i]; };
+
+	dvec3 xyz() const { return dvec3(x, y, z); }
+};
+
+template<>
+union mat<4, 4, double>
+{
+	double m[4][4] = {};
+	dvec4 v[4];
+
+	#if QM_USE_AVX
+
+	__m256d packed[4]; //array of columns
+
+	#endif
+
+	mat() {};
+
+	inline dvec4& operator[](size_t i) { return v[i]; };
+};
+
+template<>
+union qua<double>
+{
+	double q[4] = {};
+	struct{ double x, y, z, w; };
+
+	#if QM_USE_AVX
+
+	__m256d packed;
+
+	#endif
+
+	qua() {};
+	qua(double _x, double _y, double _z, double _w) { x = _x, y = _y, z = _z, w = _w; };
+	qua(dvec3 _xyz, double _w) { x = _xyz.x, y = _xyz.y, z = _xyz.z, w = _w; };
+
+	template<typename U>
+	explicit qua(const qua<U>& _q) { x = (double)_q.x, y = (double)_q.y, z = (double)_q.z, w = (double)_q.w; };
+
+	inline double operator[](size_t i) { return q[i]; };
+};
+
+//-----------------------------//
+//integer specializations, packed into SSE registers:
+
+//a 4-dimensional vector of signed integers
+template<>
+union vec<4, int32_t>
+{
+	int32_t v[4] = {};
+	struct{ int32_t x, y, z, w; };
+
+	#if QM_USE_SSE
+
+	__m128i packed;
+
+	#endif
+
+	vec() {};
+	vec(int32_t _x, int32_t _y, int32_t _z, int32_t _w) { x = _x, y = _y, z = _z, w = _w; };
+	vec(ivec3 _xyz, int32_t _w) { x = _xyz.x, y = _xyz.y, z = _xyz.z, w = _w; };
+	vec(int32_t _val) { x = _val, y = _val, z = _val, w = _val; };
+
+	template<typename U>
+	explicit vec(const vec<4, U>& _v) { x = (int32_t)_v.x, y = (int32_t)_v.y, z = (int32_t)_v.z, w = (int32_t)_v.w; };
+
+	inline int32_t& operator[](size_t i) { return v[i]; };
+
+	ivec3 xyz() const { return ivec3(x, y, z); }
+};
+
+//a 4-dimensional vector of unsigned integers
+template<>
+union vec<4, uint32_t>
+{
+	uint32_t v[4] = {};
+	struct{ uint32_t x, y, z, w; };
+
+	#if QM_USE_SSE
+
+	__m128i packed;
+
+	#endif
+
+	vec() {};
+	vec(uint32_t _x, uint32_t _y, uint32_t _z, uint32_t _w) { x = _x, y = _y, z = _z, w = _w; };
+	vec(uvec3 _xyz, uint32_t _w) { x = _xyz.x, y = _xyz.y, z = _xyz.z, w = _w; };
+	vec(uint32_t _val) { x = _val, y = _val, z = _val, w = _val; };
+
+	template<typename U>
+	explicit vec(const vec<4, U>& _v) { x = (uint32_t)_v.x, y = (uint32_t)_v.y, z = (uint32_t)_v.z, w = (uint32_t)_v.w; };
+
+	inline uint32_t& operator[](size_t i) { return v[i]; };
+
+	uvec3 xyz() const { return uvec3(x, y, z); }
+};
+
+//-----------------------------//
+//packets store 4 values as SoA, one lane per element
+
+//4 3-dimensional vectors
+struct vec3x4
+{
+	vec4 x, y, z;
+
+	vec3x4() {};
+	vec3x4(const vec4& _x, const vec4& _y, const vec4& _z) { x = _x, y = _y, z = _z; };
+	vec3x4(const vec3& _val) { x = vec4(_val.x), y = vec4(_val.y), z = vec4(_val.z); };
+	vec3x4(const vec3& _v0, const vec3& _v1, const vec3& _v2, const vec3& _v3)
+	{
+		x = vec4(_v0.x, _v1.x, _v2.x, _v3.x);
+		y = vec4(_v0.y, _v1.y, _v2.y, _v3.y);
+		z = vec4(_v0.z, _v1.z, _v2.z, _v3.z);
+	};
+
+	vec3 lane(size_t i) const { return vec3(x.v[i], y.v[i], z.v[i]); };
+};
+
+//-----------------------------//
+
+//an axis-aligned bounding box
+struct aabb
+{
+	vec3 min = vec3( INFINITY);
+	vec3 max = vec3(-INFINITY);
+
+	aabb() {};
+	aabb(const vec3& _min, const vec3& _max) { min = _min, max = _max; };
+};
+
+//4 axis-aligned bounding boxes
+struct aabb4
+{
+	vec3x4 min;
+	vec3x4 max;
+
+	aabb4() {};
+	aabb4(const aabb& _b0, const aabb& _b1, const aabb& _b2, const aabb& _b3)
+	{
+		min = vec3x4(_b0.min, _b1.min, _b2.min, _b3.min);
+		max = vec3x4(_b0.max, _b1.max, _b2.max, _b3.max);
+	};
+};
+
+//a plane, the points p where dot(normal, p) + d = 0
+struct plane
+{
+	vec3 normal;
+	float d;
+
+	plane() {};
+	plane(const vec3& _normal, float _d) { normal = _normal, d = _d; };
+	plane(const vec3& _normal, const vec3& _point);
+};
+
+struct sphere
+{
+	vec3 center;
+	float radius;
+
+	sphere() {};
+	sphere(const vec3& _center, float _radius) { center = _center, radius = _radius; };
+};
+
+struct segment
+{
+	vec3 a;
+	vec3 b;
+
+	segment() {};
+	segment(const vec3& _a, const vec3& _b) { a = _a, b = _b; };
+};
+
+//all points within radius of the segment (a, b)
+struct capsule
+{
+	vec3 a;
+	vec3 b;
+	float radius;
+
+	capsule() {};
+	capsule(const vec3& _a, const vec3& _b, float _radius) { a = _a, b = _b, radius = _radius; };
+};
+
+//an oriented bounding box, the columns of axes are its local x, y and z axes
+struct obb
+{
+	vec3 center;
+	mat3 axes;
+	vec3 halfExtents;
+
+	obb() {};
+	obb(const vec3& _center, const mat3& _axes, const vec3& _halfExtents) { center = _center, axes = _axes, halfExtents = _halfExtents; };
+	obb(const vec3& _center, const quaternion& _rotation, const vec3& _halfExtents);
+};
+
+//4 triangles, stored as their first vertex and the edges to the other two
+struct triangle4
+{
+	vec3x4 v0;
+	vec3x4 e1;
+	vec3x4 e2;
+
+	triangle4() {};
+	triangle4(const vec3* _v0, const vec3* _v1, const vec3* _v2); //4 of each
+};
+
+//4 rays, with the reciprocal directions precomputed for slab tests
+struct ray_packet
+{
+	vec3x4 origin;
+	vec3x4 dir;
+	vec3x4 invDir;
+
+	ray_packet() {};
+	ray_packet(const vec3x4& _origin, const vec3x4& _dir);
+	ray_packet(const vec3* _origins, const vec3* _dirs);
+};
+
+//-----------------------------//
+//array views point to SoA data owned elsewhere, used by the batch primitive functions
+//input views are read-only, vec3_out_array is the destination of the batch closest_point() functions
+
+struct vec3_array
+{
+	const float* x;
+	const float* y;
+	const float* z;
+};
+
+struct vec3_out_array
+{
+	float* x;
+	float* y;
+	float* z;
+};
+
+struct sphere_array
+{
+	const float* x;
+	const float* y;
+	const float* z;
+	const float* radius;
+};
+
+struct aabb_array
+{
+	const float* minX;
+	const float* minY;
+	const float* minZ;
+	const float* maxX;
+	const float* maxY;
+	const float* maxZ;
+};
+
+//the convex hull of a set of vertices, used as a gjk()/epa() shape
+struct convex_hull
+{
+	const vec3* vertices;
+	size_t count;
+};
+
 //----------------------------------------------------------------------//
 //HELPER FUNCS:
 
@@ -279,6 +985,65 @@ inline __m128 mat4_mult_column_sse(__m128 c1, mat4 m2)
 	return result;
 }
 
+//approximates sin and cos of 4 angles (in radians) at once, max error ~1e-7 for |x| < 8192
+inline void sincos_sse(__m128 x, __m128* s, __m128* c)
+{
+	//range reduction to [-pi/4, pi/4] with the quadrant in j:
+	__m128i j = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(0.63661977236f)));
+	__m128 jf = _mm_cvtepi32_ps(j);
+	__m128 r = _mm_sub_ps(x, _mm_mul_ps(jf, _mm_set1_ps(1.5703125f)));
+	r = _mm_sub_ps(r, _mm_mul_ps(jf, _mm_set1_ps(4.837512969970703125e-4f)));
+	r = _mm_sub_ps(r, _mm_mul_ps(jf, _mm_set1_ps(7.54978995489188216e-8f)));
+
+	__m128 r2 = _mm_mul_ps(r, r);
+
+	__m128 sinr = _mm_set1_ps(-1.9515295891e-4f);
+	sinr = _mm_add_ps(_mm_mul_ps(sinr, r2), _mm_set1_ps(8.3321608736e-3f));
+	sinr = _mm_add_ps(_mm_mul_ps(sinr, r2), _mm_set1_ps(-1.6666654611e-1f));
+	sinr = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(sinr, r2), r), r);
+
+	__m128 cosr = _mm_set1_ps(2.443315711809948e-5f);
+	cosr = _mm_add_ps(_mm_mul_ps(cosr, r2), _mm_set1_ps(-1.388731625493765e-3f));
+	cosr = _mm_add_ps(_mm_mul_ps(cosr, r2), _mm_set1_ps(4.166664568298827e-2f));
+	cosr = _mm_mul_ps(_mm_mul_ps(cosr, r2), r2);
+	cosr = _mm_add_ps(_mm_sub_ps(cosr, _mm_mul_ps(r2, _mm_set1_ps(0.5f))), _mm_set1_ps(1.0f));
+
+	//quadrant 1 and 3 swap sin and cos, quadrant 2 and 3 negate sin, quadrant 1 and 2 negate cos:
+	__m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(j, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+	__m128 sinSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(j, _mm_set1_epi32(2)), 30));
+	__m128 cosSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(j, _mm_set1_epi32(1)), _mm_set1_epi32(2)), 30));
+
+	__m128 sinv = _mm_or_ps(_mm_and_ps(swap, cosr), _mm_andnot_ps(swap, sinr));
+	__m128 cosv = _mm_or_ps(_mm_and_ps(swap, sinr), _mm_andnot_ps(swap, cosr));
+
+	*s = _mm_xor_ps(sinv, sinSign);
+	*c = _mm_xor_ps(cosv, cosSign);
+}
+
+//approximates acos of 4 values in [-1, 1] at once, max error ~2e-7
+inline __m128 acos_sse(__m128 x)
+{
+	__m128 signMask = _mm_set1_ps(-0.0f);
+	__m128 ax = _mm_andnot_ps(signMask, x);
+
+	__m128 p = _mm_set1_ps(-0.0012624911f);
+	p = _mm_add_ps(_mm_mul_ps(p, ax), _mm_set1_ps( 0.0066700901f));
+	p = _mm_add_ps(_mm_mul_ps(p, ax), _mm_set1_ps(-0.0170881256f));
+	p = _mm_add_ps(_mm_mul_ps(p, ax), _mm_set1_ps( 0.0308918810f));
+	p = _mm_add_ps(_mm_mul_ps(p, ax), _mm_set1_ps(-0.0501743046f));
+	p = _mm_add_ps(_mm_mul_ps(p, ax), _mm_set1_ps( 0.0889789874f));
+	p = _mm_add_ps(_mm_mul_ps(p, ax), _mm_set1_ps(-0.2145988016f));
+	p = _mm_add_ps(_mm_mul_ps(p, ax), _mm_set1_ps( 1.5707963050f));
+
+	__m128 r = _mm_mul_ps(_mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(1.0f), ax), _mm_setzero_ps())), p);
+
+	//acos(-x) = pi - acos(x):
+	__m128 negative = _mm_cmplt_ps(x, _mm_setzero_ps());
+	__m128 flipped = _mm_sub_ps(_mm_set1_ps(3.14159265359f), r);
+
+	return _mm_or_ps(_mm_and_ps(negative, flipped), _mm_andnot_ps(negative, r));
+}
+
 #endif
 
 //----------------------------------------------------------------------//
@@ -936,6 +1701,35 @@ inline vec4 max(const vec4& v1, const vec4& v2)
 	return result;
 }
 
+//linear interpolation:
+
+inline vec2 lerp(const vec2& v1, const vec2& v2, float a)
+{
+	vec2 result;
+
+	result = v1 + (v2 - v1) * a;
+
+	return result;
+}
+
+inline vec3 lerp(const vec3& v1, const vec3& v2, float a)
+{
+	vec3 result;
+
+	result = v1 + (v2 - v1) * a;
+
+	return result;
+}
+
+inline vec4 lerp(const vec4& v1, const vec4& v2, float a)
+{
+	vec4 result;
+
+	result = v1 + (v2 - v1) * a;
+
+	return result;
+}
+
 //----------------------------------------------------------------------//
 //MATRIX FUNCTIONS:
 
@@ -1850,37 +2644,137 @@ inline quaternion slerp(const quaternion& q1, const quaternion& q2, float a)
 	return result;
 }
 
-inline bool operator==(const quaternion& q1, const quaternion& q2)
+//normalized lerp, takes the shortest path:
+inline quaternion nlerp(const quaternion& q1, const quaternion& q2, float a)
 {
-	bool result;
+	quaternion result;
 
-	//TODO: there are SIMD instructions for floating point equality, find a way to get a single bool from them
-	result = (q1.x == q2.x) && (q1.y == q2.y) && (q1.z == q2.z) && (q1.w == q2.w); 
+	float s2 = dot(q1, q2) < 0.0f ? -a : a;
+	result = q1 * (1.0f - a) + q2 * s2;
+	result = normalize(result);
 
-	return result;	
+	return result;
 }
 
-inline bool operator!=(const quaternion& q1, const quaternion& q2)
+//logarithm of a unit quaternion, the result has w = 0:
+inline quaternion log(const quaternion& q)
 {
-	bool result;
+	quaternion result;
 
-	result = (q1.x != q2.x) || (q1.y != q2.y) || (q1.z != q2.z) || (q1.w != q2.w); 
+	float vlen = QM_SQRTF(q.x * q.x + q.y * q.y + q.z * q.z);
+	float angle = QM_ATAN2F(vlen, q.w);
+	float scale = vlen > 1e-6f ? angle / vlen : 1.0f;
+
+	result.x = q.x * scale;
+	result.y = q.y * scale;
+	result.z = q.z * scale;
+	result.w = 0.0f;
 
 	return result;
 }
 
-inline quaternion quaternion_from_axis_angle(const vec3& axis, float angle)
+//exponential of a pure quaternion (w = 0), the result is a unit quaternion:
+inline quaternion exp(const quaternion& q)
 {
 	quaternion result;
 
-	float radians = deg_to_rad(angle * 0.5f);
-	vec3 normalized = normalize(axis);
-	float sine = QM_SINF(radians);
+	float angle = QM_SQRTF(q.x * q.x + q.y * q.y + q.z * q.z);
+	float sine = QM_SINF(angle);
+	float scale = angle > 1e-6f ? sine / angle : 1.0f;
 
-	result.x = normalized.x * sine;
-	result.y = normalized.y * sine;
-	result.z = normalized.z * sine;
-	result.w = QM_COSF(radians);
+	result.x = q.x * scale;
+	result.y = q.y * scale;
+	result.z = q.z * scale;
+	result.w = QM_COSF(angle);
+
+	return result;
+}
+
+//slerp without shortest-path correction, falling back to nlerp for nearly identical rotations:
+inline quaternion slerp_no_invert(const quaternion& q1, const quaternion& q2, float a)
+{
+	quaternion result;
+
+	float cosine = dot(q1, q2);
+	if(QM_ABS(cosine) > 0.9995f)
+		result = normalize(q1 * (1.0f - a) + q2 * a);
+	else
+		result = slerp(q1, q2, a);
+
+	return result;
+}
+
+//spherical quadrangle interpolation between q1 and q2, with s1 and s2 from squad_control():
+inline quaternion squad(const quaternion& q1, const quaternion& q2, const quaternion& s1, const quaternion& s2, float a)
+{
+	quaternion result;
+
+	quaternion outer = slerp_no_invert(q1, q2, a);
+	quaternion inner = slerp_no_invert(s1, s2, a);
+	result = slerp_no_invert(outer, inner, 2.0f * a * (1.0f - a));
+
+	return result;
+}
+
+//the intermediate squad control point for q1, given its neighboring keys:
+inline quaternion squad_control(const quaternion& q0, const quaternion& q1, const quaternion& q2)
+{
+	quaternion result;
+
+	quaternion inv = conjugate(q1);
+	quaternion prev = dot(q0, q1) < 0.0f ? q0 * -1.0f : q0;
+	quaternion next = dot(q2, q1) < 0.0f ? q2 * -1.0f : q2;
+
+	quaternion l = log(inv * prev) + log(inv * next);
+	result = q1 * exp(l * -0.25f);
+
+	return result;
+}
+
+//C1-continuous spline through q1 and q2, with tangents from the surrounding keys:
+inline quaternion catmull_rom(const quaternion& q0, const quaternion& q1, const quaternion& q2, const quaternion& q3, float a)
+{
+	quaternion result;
+
+	quaternion next = dot(q1, q2) < 0.0f ? q2 * -1.0f : q2;
+	quaternion s1 = squad_control(q0, q1, next);
+	quaternion s2 = squad_control(q1, next, q3);
+	result = squad(q1, next, s1, s2, a);
+
+	return result;
+}
+
+inline bool operator==(const quaternion& q1, const quaternion& q2)
+{
+	bool result;
+
+	//TODO: there are SIMD instructions for floating point equality, find a way to get a single bool from them
+	result = (q1.x == q2.x) && (q1.y == q2.y) && (q1.z == q2.z) && (q1.w == q2.w); 
+
+	return result;	
+}
+
+inline bool operator!=(const quaternion& q1, const quaternion& q2)
+{
+	bool result;
+
+	result = (q1.x != q2.x) || (q1.y != q2.y) || (q1.z != q2.z) || (q1.w != q2.w); 
+
+	return result;
+}
+
+inline quaternion quaternion_from_axis_angle(const vec3& axis, float angle)
+{
+	quaternion result;
+
+	float radians = deg_to_rad(angle * 0.5f);
+	vec3 normalized = normalize(axis);
+	float sine = QM_SINF(radians);
+
+	result.x = normalized.x * sine;
+	result.y = normalized.y * sine;
+	result.z = normalized.z * sine;
+	result.w = QM_COSF(radians);
 
 	return result;
 }
@@ -1957,6 +2851,7327 @@ inline mat4 quaternion_to_mat4(const quaternion& q)
 	return result;
 }
 
+//inverse of quaternion_to_mat4 for a rotation matrix, picks the best-conditioned of the four solutions
+inline quaternion quaternion_from_mat3(const mat3& m)
+{
+	quaternion result;
+
+	float trace = m.m[0][0] + m.m[1][1] + m.m[2][2];
+	if(trace > 0.0f)
+	{
+		float s = 0.5f / QM_SQRTF(trace + 1.0f);
+		result.w = 0.25f / s;
+		result.x = (m.m[2][1] - m.m[1][2]) * s;
+		result.y = (m.m[0][2] - m.m[2][0]) * s;
+		result.z = (m.m[1][0] - m.m[0][1]) * s;
+	}
+	else if(m.m[0][0] > m.m[1][1] && m.m[0][0] > m.m[2][2])
+	{
+		float s = 0.5f / QM_SQRTF(1.0f + m.m[0][0] - m.m[1][1] - m.m[2][2]);
+		result.w = (m.m[2][1] - m.m[1][2]) * s;
+		result.x = 0.25f / s;
+		result.y = (m.m[0][1] + m.m[1][0]) * s;
+		result.z = (m.m[0][2] + m.m[2][0]) * s;
+	}
+	else if(m.m[1][1] > m.m[2][2])
+	{
+		float s = 0.5f / QM_SQRTF(1.0f + m.m[1][1] - m.m[0][0] - m.m[2][2]);
+		result.w = (m.m[0][2] - m.m[2][0]) * s;
+		result.x = (m.m[0][1] + m.m[1][0]) * s;
+		result.y = 0.25f / s;
+		result.z = (m.m[1][2] + m.m[2][1]) * s;
+	}
+	else
+	{
+		float s = 0.5f / QM_SQRTF(1.0f + m.m[2][2] - m.m[0][0] - m.m[1][1]);
+		result.w = (m.m[1][0] - m.m[0][1]) * s;
+		result.x = (m.m[0][2] + m.m[2][0]) * s;
+		result.y = (m.m[1][2] + m.m[2][1]) * s;
+		result.z = 0.25f / s;
+	}
+
+	return result;
+}
+
+//----------------------------------------------------------------------//
+//TRANSFORM FUNCTIONS:
+
+#if QM_USE_SSE
+
+//composes the 4 transforms at t/r/s[idx[0..3]] and writes them to *out[0..3]
+inline void compose_sse(const vec3* t, const quaternion* r, const vec3* s, const uint32_t* idx, mat4* const* out)
+{
+	__m128 x = r[idx[0]].packed;
+	__m128 y = r[idx[1]].packed;
+	__m128 z = r[idx[2]].packed;
+	__m128 w = r[idx[3]].packed;
+	_MM_TRANSPOSE4_PS(x, y, z, w);
+
+	__m128 sx = _mm_setr_ps(s[idx[0]].x, s[idx[1]].x, s[idx[2]].x, s[idx[3]].x);
+	__m128 sy = _mm_setr_ps(s[idx[0]].y, s[idx[1]].y, s[idx[2]].y, s[idx[3]].y);
+	__m128 sz = _mm_setr_ps(s[idx[0]].z, s[idx[1]].z, s[idx[2]].z, s[idx[3]].z);
+
+	__m128 x2 = _mm_add_ps(x, x);
+	__m128 y2 = _mm_add_ps(y, y);
+	__m128 z2 = _mm_add_ps(z, z);
+	__m128 xx2 = _mm_mul_ps(x, x2);
+	__m128 xy2 = _mm_mul_ps(x, y2);
+	__m128 xz2 = _mm_mul_ps(x, z2);
+	__m128 yy2 = _mm_mul_ps(y, y2);
+	__m128 yz2 = _mm_mul_ps(y, z2);
+	__m128 zz2 = _mm_mul_ps(z, z2);
+	__m128 sx2 = _mm_mul_ps(w, x2);
+	__m128 sy2 = _mm_mul_ps(w, y2);
+	__m128 sz2 = _mm_mul_ps(w, z2);
+
+	__m128 one  = _mm_set1_ps(1.0f);
+	__m128 zero = _mm_setzero_ps();
+
+	__m128 c00 = _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(yy2, zz2)), sx);
+	__m128 c01 = _mm_mul_ps(_mm_sub_ps(xy2, sz2), sx);
+	__m128 c02 = _mm_mul_ps(_mm_add_ps(xz2, sy2), sx);
+	__m128 c03 = zero;
+	__m128 c10 = _mm_mul_ps(_mm_add_ps(xy2, sz2), sy);
+	__m128 c11 = _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx2, zz2)), sy);
+	__m128 c12 = _mm_mul_ps(_mm_sub_ps(yz2, sx2), sy);
+	__m128 c13 = zero;
+	__m128 c20 = _mm_mul_ps(_mm_sub_ps(xz2, sy2), sz);
+	__m128 c21 = _mm_mul_ps(_mm_add_ps(yz2, sx2), sz);
+	__m128 c22 = _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx2, yy2)), sz);
+	__m128 c23 = zero;
+
+	//transpose from SoA back to one column per matrix:
+	_MM_TRANSPOSE4_PS(c00, c01, c02, c03);
+	_MM_TRANSPOSE4_PS(c10, c11, c12, c13);
+	_MM_TRANSPOSE4_PS(c20, c21, c22, c23);
+
+	out[0]->packed[0] = c00; out[0]->packed[1] = c10; out[0]->packed[2] = c20;
+	out[1]->packed[0] = c01; out[1]->packed[1] = c11; out[1]->packed[2] = c21;
+	out[2]->packed[0] = c02; out[2]->packed[1] = c12; out[2]->packed[2] = c22;
+	out[3]->packed[0] = c03; out[3]->packed[1] = c13; out[3]->packed[2] = c23;
+
+	out[0]->packed[3] = _mm_setr_ps(t[idx[0]].x, t[idx[0]].y, t[idx[0]].z, 1.0f);
+	out[1]->packed[3] = _mm_setr_ps(t[idx[1]].x, t[idx[1]].y, t[idx[1]].z, 1.0f);
+	out[2]->packed[3] = _mm_setr_ps(t[idx[2]].x, t[idx[2]].y, t[idx[2]].z, 1.0f);
+	out[3]->packed[3] = _mm_setr_ps(t[idx[3]].x, t[idx[3]].y, t[idx[3]].z, 1.0f);
+}
+
+#endif
+
+//composition:
+
+inline mat4 compose(const vec3& t, const quaternion& r, const vec3& s)
+{
+	//equivalent to translate(t) * quaternion_to_mat4(r) * scale(s)
+
+	mat4 result;
+
+	float x2  = r.x + r.x;
+	float y2  = r.y + r.y;
+	float z2  = r.z + r.z;
+	float xx2 = r.x * x2;
+	float xy2 = r.x * y2;
+	float xz2 = r.x * z2;
+	float yy2 = r.y * y2;
+	float yz2 = r.y * z2;
+	float zz2 = r.z * z2;
+	float sx2 = r.w * x2;
+	float sy2 = r.w * y2;
+	float sz2 = r.w * z2;
+
+	result.m[0][0] = (1.0f - (yy2 + zz2)) * s.x;
+	result.m[0][1] = (xy2 - sz2) * s.x;
+	result.m[0][2] = (xz2 + sy2) * s.x;
+	result.m[1][0] = (xy2 + sz2) * s.y;
+	result.m[1][1] = (1.0f - (xx2 + zz2)) * s.y;
+	result.m[1][2] = (yz2 - sx2) * s.y;
+	result.m[2][0] = (xz2 - sy2) * s.z;
+	result.m[2][1] = (yz2 + sx2) * s.z;
+	result.m[2][2] = (1.0f - (xx2 + yy2)) * s.z;
+	result.m[3][0] = t.x;
+	result.m[3][1] = t.y;
+	result.m[3][2] = t.z;
+	result.m[3][3] = 1.0f;
+
+	return result;
+}
+
+//how compose_gather() stores its results:
+enum compose_store
+{
+	COMPOSE_STORE_MATRICES,        //plain stores of whole matrices
+	COMPOSE_STORE_MATRICES_STREAM, //non-temporal stores of whole matrices, out must be 16-byte aligned
+	COMPOSE_STORE_ROWS_STREAM      //non-temporal stores of the top 3 rows (3 vec4s per matrix), out must be 16-byte aligned
+};
+
+//composes the transforms at indices[0..n) (or [0..n) if indices is nullptr) and writes them tightly packed to out
+//out points to mat4s, or to vec4s for COMPOSE_STORE_ROWS_STREAM
+inline void compose_gather(const vec3* t, const quaternion* r, const vec3* s, const uint32_t* indices, size_t n, void* out, compose_store store)
+{
+	mat4* outMats = (mat4*)out;
+	vec4* outRows = (vec4*)out;
+
+	size_t i = 0;
+
+	#if QM_USE_SSE
+
+	mat4 tmp[4];
+
+	for(; i + 4 <= n; i += 4)
+	{
+		uint32_t localIdx[4] = {(uint32_t)i, (uint32_t)i + 1, (uint32_t)i + 2, (uint32_t)i + 3};
+		const uint32_t* idx = indices ? &indices[i] : localIdx;
+
+		if(store == COMPOSE_STORE_MATRICES)
+		{
+			mat4* dst[4] = {&outMats[i], &outMats[i + 1], &outMats[i + 2], &outMats[i + 3]};
+			compose_sse(t, r, s, idx, dst);
+			continue;
+		}
+
+		mat4* dst[4] = {&tmp[0], &tmp[1], &tmp[2], &tmp[3]};
+		compose_sse(t, r, s, idx, dst);
+
+		for(int l = 0; l < 4; l++)
+		{
+			if(store == COMPOSE_STORE_MATRICES_STREAM)
+			{
+				float* o = outMats[i + l].m[0];
+				_mm_stream_ps(o     , tmp[l].packed[0]);
+				_mm_stream_ps(o +  4, tmp[l].packed[1]);
+				_mm_stream_ps(o +  8, tmp[l].packed[2]);
+				_mm_stream_ps(o + 12, tmp[l].packed[3]);
+			}
+			else
+			{
+				__m128 r0 = tmp[l].packed[0];
+				__m128 r1 = tmp[l].packed[1];
+				__m128 r2 = tmp[l].packed[2];
+				__m128 r3 = tmp[l].packed[3];
+				_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+				float* o = outRows[(i + l) * 3].v;
+				_mm_stream_ps(o    , r0);
+				_mm_stream_ps(o + 4, r1);
+				_mm_stream_ps(o + 8, r2);
+			}
+		}
+	}
+
+	if(store != COMPOSE_STORE_MATRICES)
+		_mm_sfence();
+
+	#endif
+
+	for(; i < n; i++)
+	{
+		uint32_t idx = indices ? indices[i] : (uint32_t)i;
+		mat4 m = compose(t[idx], r[idx], s[idx]);
+
+		if(store == COMPOSE_STORE_ROWS_STREAM)
+		{
+			for(int row = 0; row < 3; row++)
+				outRows[i * 3 + row] = vec4(m.m[0][row], m.m[1][row], m.m[2][row], m.m[3][row]);
+		}
+		else
+			outMats[i] = m;
+	}
+}
+
+inline void compose(const vec3* t, const quaternion* r, const vec3* s, mat4* out, size_t n)
+{
+	compose_gather(t, r, s, nullptr, n, out, COMPOSE_STORE_MATRICES);
+}
+
+//gathers the transforms at indices[0..n) and writes them tightly packed to out[0..n)
+inline void compose(const vec3* t, const quaternion* r, const vec3* s, const uint32_t* indices, mat4* out, size_t n)
+{
+	compose_gather(t, r, s, indices, n, out, COMPOSE_STORE_MATRICES);
+}
+
+//affine multiplication (both matrices must have a bottom row of 0, 0, 0, 1):
+
+inline mat4 mult_affine(const mat4& m1, const mat4& m2)
+{
+	mat4 result;
+
+	#if QM_USE_SSE
+
+	for(int i = 0; i < 3; i++)
+	{
+		__m128 c = m2.packed[i];
+		result.packed[i] =                              _mm_mul_ps(_mm_shuffle_ps(c, c, _MM_SHUFFLE(0, 0, 0, 0)), m1.packed[0]);
+		result.packed[i] = _mm_add_ps(result.packed[i], _mm_mul_ps(_mm_shuffle_ps(c, c, _MM_SHUFFLE(1, 1, 1, 1)), m1.packed[1]));
+		result.packed[i] = _mm_add_ps(result.packed[i], _mm_mul_ps(_mm_shuffle_ps(c, c, _MM_SHUFFLE(2, 2, 2, 2)), m1.packed[2]));
+	}
+
+	__m128 c = m2.packed[3];
+	result.packed[3] =                              _mm_mul_ps(_mm_shuffle_ps(c, c, _MM_SHUFFLE(0, 0, 0, 0)), m1.packed[0]);
+	result.packed[3] = _mm_add_ps(result.packed[3], _mm_mul_ps(_mm_shuffle_ps(c, c, _MM_SHUFFLE(1, 1, 1, 1)), m1.packed[1]));
+	result.packed[3] = _mm_add_ps(result.packed[3], _mm_mul_ps(_mm_shuffle_ps(c, c, _MM_SHUFFLE(2, 2, 2, 2)), m1.packed[2]));
+	result.packed[3] = _mm_add_ps(result.packed[3], m1.packed[3]);
+
+	#else
+
+	for(int i = 0; i < 4; i++)
+	{
+		result.m[i][0] = m1.m[0][0] * m2.m[i][0] + m1.m[1][0] * m2.m[i][1] + m1.m[2][0] * m2.m[i][2];
+		result.m[i][1] = m1.m[0][1] * m2.m[i][0] + m1.m[1][1] * m2.m[i][1] + m1.m[2][1] * m2.m[i][2];
+		result.m[i][2] = m1.m[0][2] * m2.m[i][0] + m1.m[1][2] * m2.m[i][1] + m1.m[2][2] * m2.m[i][2];
+		result.m[i][3] = 0.0f;
+	}
+
+	result.m[3][0] += m1.m[3][0];
+	result.m[3][1] += m1.m[3][1];
+	result.m[3][2] += m1.m[3][2];
+	result.m[3][3] = 1.0f;
+
+	#endif
+
+	return result;
+}
+
+//instance buffers:
+
+//composes n instances into a tightly packed array of matrices, ready to be uploaded for instanced rendering
+//if visible is not nullptr, it lists the n instances to emit, so culled instances are compacted away in the same pass
+//out must be 16-byte aligned, non-temporal stores are used since the buffer is usually only read by the GPU
+inline void build_instance_matrices(const vec3* pos, const quaternion* rot, const vec3* scl, const uint32_t* visible, size_t n, mat4* out)
+{
+	compose_gather(pos, rot, scl, visible, n, out, COMPOSE_STORE_MATRICES_STREAM);
+}
+
+//same as build_instance_matrices(), but writes the top 3 rows of each matrix (3 vec4s per instance)
+inline void build_instance_rows(const vec3* pos, const quaternion* rot, const vec3* scl, const uint32_t* visible, size_t n, vec4* out)
+{
+	compose_gather(pos, rot, scl, visible, n, out, COMPOSE_STORE_ROWS_STREAM);
+}
+
+//----------------------------------------------------------------------//
+//TRANSFORM HIERARCHY:
+
+//stores local TRS transforms and parent indices, and computes world matrices
+//
+//nodes are stored in contiguous arrays in parent-first order (every parent is stored before
+//its children), so update() is a single forward streaming pass that only recomputes the subtrees
+//whose local transforms changed since the last update. nodes are referred to by stable ids,
+//while the public arrays are indexed by slot (slotOf[id]), which changes when nodes are
+//removed or reparented. relinearize() sorts all nodes breadth-first
+struct transform_hierarchy
+{
+	static const uint8_t LOCAL_DIRTY = 1;
+	static const uint8_t WORLD_DIRTY = 2;
+	static const uint8_t MARKED      = 4;
+
+	size_t count    = 0;
+	size_t capacity = 0;
+
+	//indexed by slot:
+	vec3*       positions = nullptr;
+	quaternion* rotations = nullptr;
+	vec3*       scales    = nullptr;
+	int*        parents   = nullptr; //slot of the parent, -1 for root nodes
+	uint8_t*    flags     = nullptr;
+	mat4*       locals    = nullptr;
+	mat4*       worlds    = nullptr;
+	int*        idOf      = nullptr;
+
+	//indexed by id:
+	int*   slotOf  = nullptr; //-1 for unused ids
+	int*   freeIds = nullptr;
+	size_t numIds  = 0;
+	size_t numFree = 0;
+
+	uint32_t* localList = nullptr; //scratch for update() and reordering
+	uint32_t* worldList = nullptr;
+
+	transform_hierarchy() {};
+	transform_hierarchy(size_t initialCapacity) { reserve(initialCapacity); };
+	~transform_hierarchy()
+	{
+		QM_FREE(positions);
+		QM_FREE(rotations);
+		QM_FREE(scales);
+		QM_FREE(parents);
+		QM_FREE(flags);
+		QM_FREE(locals);
+		QM_FREE(worlds);
+		QM_FREE(idOf);
+		QM_FREE(slotOf);
+		QM_FREE(freeIds);
+		QM_FREE(localList);
+		QM_FREE(worldList);
+	};
+
+	transform_hierarchy(const transform_hierarchy&) = delete;
+	transform_hierarchy& operator=(const transform_hierarchy&) = delete;
+
+	void reserve(size_t newCapacity)
+	{
+		if(newCapacity <= capacity)
+			return;
+
+		positions = (vec3*)      QM_REALLOC(positions, newCapacity * sizeof(vec3));
+		rotations = (quaternion*)QM_REALLOC(rotations, newCapacity * sizeof(quaternion));
+		scales    = (vec3*)      QM_REALLOC(scales   , newCapacity * sizeof(vec3));
+		parents   = (int*)       QM_REALLOC(parents  , newCapacity * sizeof(int));
+		flags     = (uint8_t*)   QM_REALLOC(flags    , newCapacity * sizeof(uint8_t));
+		locals    = (mat4*)      QM_REALLOC(locals   , newCapacity * sizeof(mat4));
+		worlds    = (mat4*)      QM_REALLOC(worlds   , newCapacity * sizeof(mat4));
+		idOf      = (int*)       QM_REALLOC(idOf     , newCapacity * sizeof(int));
+		slotOf    = (int*)       QM_REALLOC(slotOf   , newCapacity * sizeof(int));
+		freeIds   = (int*)       QM_REALLOC(freeIds  , newCapacity * sizeof(int));
+		localList = (uint32_t*)  QM_REALLOC(localList, newCapacity * sizeof(uint32_t));
+		worldList = (uint32_t*)  QM_REALLOC(worldList, newCapacity * sizeof(uint32_t));
+
+		capacity = newCapacity;
+	};
+
+	//adds a node and returns its id, parent must be -1 or the id of an existing node
+	int add(int parent, const vec3& pos = vec3(0.0f), const quaternion& rot = quaternion_identity(), const vec3& scl = vec3(1.0f))
+	{
+		if(count == capacity)
+			reserve(capacity < 16 ? 16 : capacity * 2);
+
+		int id = numFree > 0 ? freeIds[--numFree] : (int)numIds++;
+		int slot = (int)count++;
+
+		positions[slot] = pos;
+		rotations[slot] = rot;
+		scales   [slot] = scl;
+		parents  [slot] = parent >= 0 ? slotOf[parent] : -1;
+		flags    [slot] = LOCAL_DIRTY;
+		idOf     [slot] = id;
+		slotOf   [id]   = slot;
+
+		return id;
+	};
+
+	//removes a node along with its entire subtree
+	void remove(int node)
+	{
+		size_t first = (size_t)slotOf[node];
+		mark_subtree(first);
+
+		size_t numKept = 0;
+		for(size_t i = first; i < count; i++)
+		{
+			if(flags[i] & MARKED)
+			{
+				slotOf[idOf[i]] = -1;
+				freeIds[numFree++] = idOf[i];
+			}
+			else
+				localList[numKept++] = (uint32_t)i;
+		}
+
+		reorder(first, numKept);
+		count = first + numKept;
+	};
+
+	//moves a node (and its subtree) under a new parent (-1 to make it a root)
+	//returns false without changing anything if the new parent is inside the node's subtree
+	bool reparent(int node, int newParent)
+	{
+		int slot = slotOf[node];
+		int parentSlot = newParent >= 0 ? slotOf[newParent] : -1;
+
+		//parent-first order is already satisfied, no need to move anything:
+		if(parentSlot < slot)
+		{
+			parents[slot] = parentSlot;
+			flags[slot] |= WORLD_DIRTY;
+			return true;
+		}
+
+		size_t first = (size_t)slot;
+		mark_subtree(first);
+
+		if(flags[parentSlot] & MARKED)
+		{
+			for(size_t i = first; i < count; i++)
+				flags[i] &= ~MARKED;
+
+			return false;
+		}
+
+		//stable partition, moving the subtree after everything else (and thus after its new parent):
+		size_t n = 0;
+		for(size_t i = first; i < count; i++)
+			if(!(flags[i] & MARKED))
+				localList[n++] = (uint32_t)i;
+		for(size_t i = first; i < count; i++)
+			if(flags[i] & MARKED)
+			{
+				flags[i] &= ~MARKED;
+				localList[n++] = (uint32_t)i;
+			}
+
+		reorder(first, n);
+
+		slot = slotOf[node];
+		parents[slot] = slotOf[newParent];
+		flags[slot] |= WORLD_DIRTY;
+
+		return true;
+	};
+
+	//sorts all nodes breadth-first (by depth), so that nodes of the same level are contiguous
+	void relinearize()
+	{
+		uint32_t* depths = worldList;
+		uint32_t maxDepth = 0;
+
+		for(size_t i = 0; i < count; i++)
+		{
+			depths[i] = parents[i] >= 0 ? depths[parents[i]] + 1 : 0;
+			maxDepth = QM_MAX(maxDepth, depths[i]);
+		}
+
+		//stable counting sort by depth:
+		uint32_t* offsets = (uint32_t*)QM_MALLOC((maxDepth + 2) * sizeof(uint32_t));
+		for(uint32_t d = 0; d < maxDepth + 2; d++)
+			offsets[d] = 0;
+		for(size_t i = 0; i < count; i++)
+			offsets[depths[i] + 1]++;
+		for(uint32_t d = 1; d < maxDepth + 2; d++)
+			offsets[d] += offsets[d - 1];
+		for(size_t i = 0; i < count; i++)
+			localList[offsets[depths[i]]++] = (uint32_t)i;
+
+		QM_FREE(offsets);
+
+		reorder(0, count);
+	};
+
+	void set_position(int node, const vec3& pos)       { int s = slotOf[node]; positions[s] = pos; flags[s] |= LOCAL_DIRTY; };
+	void set_rotation(int node, const quaternion& rot) { int s = slotOf[node]; rotations[s] = rot; flags[s] |= LOCAL_DIRTY; };
+	void set_scale   (int node, const vec3& scl)       { int s = slotOf[node]; scales   [s] = scl; flags[s] |= LOCAL_DIRTY; };
+	void set_local(int node, const vec3& pos, const quaternion& rot, const vec3& scl)
+	{
+		int s = slotOf[node];
+		positions[s] = pos;
+		rotations[s] = rot;
+		scales   [s] = scl;
+		flags    [s] |= LOCAL_DIRTY;
+	};
+
+	int parent(int node) const { int p = parents[slotOf[node]]; return p >= 0 ? idOf[p] : -1; };
+
+	//only valid after update() has been called since the last change
+	const mat4& local(int node) const { return locals[slotOf[node]]; };
+	const mat4& world(int node) const { return worlds[slotOf[node]]; };
+
+	void update()
+	{
+		size_t numLocal = 0;
+		size_t numWorld = 0;
+
+		//propagate dirtiness down from parents, collecting the nodes that need work:
+		for(size_t i = 0; i < count; i++)
+		{
+			uint8_t f = flags[i];
+			int parent = parents[i];
+
+			if(f & LOCAL_DIRTY)
+			{
+				localList[numLocal++] = (uint32_t)i;
+				f |= WORLD_DIRTY;
+			}
+			else if(parent >= 0 && (flags[parent] & WORLD_DIRTY))
+				f |= WORLD_DIRTY;
+
+			if(f & WORLD_DIRTY)
+				worldList[numWorld++] = (uint32_t)i;
+
+			flags[i] = f;
+		}
+
+		//recompute local matrices in batches:
+		size_t i = 0;
+
+		#if QM_USE_SSE
+
+		for(; i + 4 <= numLocal; i += 4)
+		{
+			mat4* dst[4] = {&locals[localList[i]], &locals[localList[i + 1]], &locals[localList[i + 2]], &locals[localList[i + 3]]};
+			compose_sse(positions, rotations, scales, &localList[i], dst);
+		}
+
+		#endif
+
+		for(; i < numLocal; i++)
+		{
+			uint32_t node = localList[i];
+			locals[node] = compose(positions[node], rotations[node], scales[node]);
+		}
+
+		//recompute world matrices, parents are always visited before their children:
+		for(i = 0; i < numWorld; i++)
+		{
+			uint32_t node = worldList[i];
+			int parent = parents[node];
+
+			if(parent >= 0)
+				worlds[node] = mult_affine(worlds[parent], locals[node]);
+			else
+				worlds[node] = locals[node];
+		}
+
+		for(i = 0; i < numWorld; i++)
+			flags[worldList[i]] = 0;
+	};
+
+private:
+	//sets MARKED on the node at the given slot and all of its descendants
+	void mark_subtree(size_t first)
+	{
+		flags[first] |= MARKED;
+		for(size_t i = first + 1; i < count; i++)
+			if(parents[i] >= (int)first && (flags[parents[i]] & MARKED))
+				flags[i] |= MARKED;
+	};
+
+	template<typename T>
+	void gather(T* arr, size_t first, size_t n, void* tmp)
+	{
+		T* moved = (T*)tmp;
+		for(size_t i = 0; i < n; i++)
+			moved[i] = arr[localList[i]];
+		for(size_t i = 0; i < n; i++)
+			arr[first + i] = moved[i];
+	};
+
+	//moves the slots listed in localList[0..n) to first..first + n, in that order
+	void reorder(size_t first, size_t n)
+	{
+		uint32_t* remap = worldList;
+		for(size_t i = 0; i < n; i++)
+			remap[localList[i]] = (uint32_t)(first + i);
+
+		void* tmp = QM_MALLOC(n * sizeof(mat4));
+
+		gather(positions, first, n, tmp);
+		gather(rotations, first, n, tmp);
+		gather(scales   , first, n, tmp);
+		gather(parents  , first, n, tmp);
+		gather(flags    , first, n, tmp);
+		gather(locals   , first, n, tmp);
+		gather(worlds   , first, n, tmp);
+		gather(idOf     , first, n, tmp);
+
+		QM_FREE(tmp);
+
+		for(size_t i = first; i < first + n; i++)
+		{
+			if(parents[i] >= (int)first)
+				parents[i] = (int)remap[parents[i]];
+			slotOf[idOf[i]] = (int)i;
+		}
+	};
+};
+
+//----------------------------------------------------------------------//
+//SKINNING:
+
+//linear blend skinning, each vertex has "influences" joint indices and weights stored contiguously
+//normals are transformed by the blended matrix and renormalized, so the palette is assumed to not
+//contain non-uniform scale. nrm and outNrm may be nullptr to only skin positions
+template<typename J>
+inline void skin_lbs_impl(const mat4* palette, const vec3* pos, const vec3* nrm, const J* joints, const float* weights, int influences,
+                          vec3* outPos, vec3* outNrm, size_t n)
+{
+	bool normals = nrm != nullptr && outNrm != nullptr;
+
+	for(size_t i = 0; i < n; i++)
+	{
+		const J*     joint  = &joints [i * influences];
+		const float* weight = &weights[i * influences];
+
+		#if QM_USE_SSE
+
+		//blend the joint matrices:
+		__m128 w = _mm_set1_ps(weight[0]);
+		const mat4& first = palette[joint[0]];
+		__m128 c0 = _mm_mul_ps(first.packed[0], w);
+		__m128 c1 = _mm_mul_ps(first.packed[1], w);
+		__m128 c2 = _mm_mul_ps(first.packed[2], w);
+		__m128 c3 = _mm_mul_ps(first.packed[3], w);
+
+		for(int k = 1; k < influences; k++)
+		{
+			if(weight[k] == 0.0f)
+				continue;
+
+			w = _mm_set1_ps(weight[k]);
+			const mat4& m = palette[joint[k]];
+			c0 = _mm_add_ps(c0, _mm_mul_ps(m.packed[0], w));
+			c1 = _mm_add_ps(c1, _mm_mul_ps(m.packed[1], w));
+			c2 = _mm_add_ps(c2, _mm_mul_ps(m.packed[2], w));
+			c3 = _mm_add_ps(c3, _mm_mul_ps(m.packed[3], w));
+		}
+
+		//transform:
+		vec4 p;
+		p.packed =                      _mm_mul_ps(c0, _mm_set1_ps(pos[i].x));
+		p.packed = _mm_add_ps(p.packed, _mm_mul_ps(c1, _mm_set1_ps(pos[i].y)));
+		p.packed = _mm_add_ps(p.packed, _mm_mul_ps(c2, _mm_set1_ps(pos[i].z)));
+		p.packed = _mm_add_ps(p.packed, c3);
+		outPos[i] = p.xyz();
+
+		if(normals)
+		{
+			__m128 r;
+			r =               _mm_mul_ps(c0, _mm_set1_ps(nrm[i].x));
+			r = _mm_add_ps(r, _mm_mul_ps(c1, _mm_set1_ps(nrm[i].y)));
+			r = _mm_add_ps(r, _mm_mul_ps(c2, _mm_set1_ps(nrm[i].z)));
+
+			//w is 0 since the columns' w components are 0 for affine matrices:
+			__m128 len2 = _mm_mul_ps(r, r);
+			len2 = _mm_hadd_ps(len2, len2);
+			len2 = _mm_hadd_ps(len2, len2);
+
+			vec4 nr;
+			nr.packed = _mm_cvtss_f32(len2) > 0.0f ? _mm_div_ps(r, _mm_sqrt_ps(len2)) : r;
+			outNrm[i] = nr.xyz();
+		}
+
+		#else
+
+		mat4 m;
+		for(int k = 0; k < influences; k++)
+		{
+			float w = weight[k];
+			const mat4& jointMat = palette[joint[k]];
+
+			for(int c = 0; c < 4; c++)
+			{
+				m.m[c][0] += jointMat.m[c][0] * w;
+				m.m[c][1] += jointMat.m[c][1] * w;
+				m.m[c][2] += jointMat.m[c][2] * w;
+			}
+		}
+
+		vec3 p = pos[i];
+		outPos[i].x = m.m[0][0] * p.x + m.m[1][0] * p.y + m.m[2][0] * p.z + m.m[3][0];
+		outPos[i].y = m.m[0][1] * p.x + m.m[1][1] * p.y + m.m[2][1] * p.z + m.m[3][1];
+		outPos[i].z = m.m[0][2] * p.x + m.m[1][2] * p.y + m.m[2][2] * p.z + m.m[3][2];
+
+		if(normals)
+		{
+			vec3 nr = nrm[i];
+			vec3 r;
+			r.x = m.m[0][0] * nr.x + m.m[1][0] * nr.y + m.m[2][0] * nr.z;
+			r.y = m.m[0][1] * nr.x + m.m[1][1] * nr.y + m.m[2][1] * nr.z;
+			r.z = m.m[0][2] * nr.x + m.m[1][2] * nr.y + m.m[2][2] * nr.z;
+
+			//same zero-length guard as the SSE path, degenerate normals pass through unchanged:
+			float len2 = dot(r, r);
+			outNrm[i] = len2 > 0.0f ? r / QM_SQRTF(len2) : r;
+		}
+
+		#endif
+	}
+}
+
+inline void skin_lbs(const mat4* palette, const vec3* pos, const vec3* nrm, const uint8_t* joints, const float* weights, int influences,
+                     vec3* outPos, vec3* outNrm, size_t n)
+{
+	skin_lbs_impl(palette, pos, nrm, joints, weights, influences, outPos, outNrm, n);
+}
+
+inline void skin_lbs(const mat4* palette, const vec3* pos, const vec3* nrm, const uint16_t* joints, const float* weights, int influences,
+                     vec3* outPos, vec3* outNrm, size_t n)
+{
+	skin_lbs_impl(palette, pos, nrm, joints, weights, influences, outPos, outNrm, n);
+}
+
+//----------------------------------------------------------------------//
+//ANIMATION:
+
+//a track of keyframes, times must be strictly increasing
+//tracks do not own their memory, the times and keys usually live in one allocation per clip
+struct vec3_track
+{
+	const float* times = nullptr;
+	const vec3*  keys  = nullptr;
+	size_t       count = 0;
+
+	vec3_track() {};
+	vec3_track(const float* _times, const vec3* _keys, size_t _count) { times = _times, keys = _keys, count = _count; };
+};
+
+struct quaternion_track
+{
+	const float*      times = nullptr;
+	const quaternion* keys  = nullptr;
+	size_t            count = 0;
+
+	quaternion_track() {};
+	quaternion_track(const float* _times, const quaternion* _keys, size_t _count) { times = _times, keys = _keys, count = _count; };
+};
+
+//returns the key k such that times[k] <= t < times[k + 1] (clamped to the first and last segment), 0 if count < 2
+//the search starts at the cached cursor, so forward playback only ever steps 0 or 1 keys
+inline size_t find_key(const float* times, size_t count, float t, size_t cursor)
+{
+	if(count < 2)
+		return 0;
+
+	size_t last = count - 2;
+	if(cursor > last)
+		cursor = last;
+
+	if(t >= times[cursor])
+	{
+		for(int i = 0; i < 4; i++)
+		{
+			if(cursor == last || t < times[cursor + 1])
+				return cursor;
+
+			cursor++;
+		}
+	}
+
+	//binary search for large jumps and rewinding:
+	size_t lo = 0;
+	size_t hi = last;
+	while(lo < hi)
+	{
+		size_t mid = (lo + hi + 1) / 2;
+		if(times[mid] <= t)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+
+	return lo;
+}
+
+//returns the interpolation factor between key k and k + 1, clamped to [0, 1]
+inline float key_alpha(const float* times, size_t count, size_t k, float t)
+{
+	if(count < 2)
+		return 0.0f;
+
+	float result = (t - times[k]) / (times[k + 1] - times[k]);
+	result = QM_MAX(result, 0.0f);
+	result = QM_MIN(result, 1.0f);
+
+	return result;
+}
+
+//single track sampling, empty tracks (count == 0) return zero or the identity:
+
+inline vec3 sample_track(const vec3_track& track, float t, size_t* cursor)
+{
+	size_t k = find_key(track.times, track.count, t, *cursor);
+	*cursor = k;
+
+	if(track.count == 0)
+		return vec3(0.0f);
+
+	if(track.count < 2)
+		return track.keys[0];
+
+	return lerp(track.keys[k], track.keys[k + 1], key_alpha(track.times, track.count, k, t));
+}
+
+inline quaternion sample_track(const quaternion_track& track, float t, size_t* cursor, bool useSlerp = false)
+{
+	size_t k = find_key(track.times, track.count, t, *cursor);
+	*cursor = k;
+
+	if(track.count == 0)
+		return quaternion_identity();
+
+	if(track.count < 2)
+		return track.keys[0];
+
+	float a = key_alpha(track.times, track.count, k, t);
+	quaternion q1 = track.keys[k];
+	quaternion q2 = track.keys[k + 1];
+
+	if(!useSlerp)
+		return nlerp(q1, q2, a);
+
+	float cosine = dot(q1, q2);
+	if(cosine < 0.0f)
+	{
+		q2 = q2 * -1.0f;
+		cosine = -cosine;
+	}
+
+	if(cosine > 0.9995f)
+		return nlerp(q1, q2, a);
+
+	return slerp(q1, q2, a);
+}
+
+//batch sampling, evaluates n tracks at the same time t
+//cursors holds one cached key per track and should be zero-initialized
+
+inline void sample_tracks(const vec3_track* tracks, size_t* cursors, float t, vec3* out, size_t n)
+{
+	size_t i = 0;
+
+	#if QM_USE_SSE
+
+	for(; i + 4 <= n; i += 4)
+	{
+		vec3 a[4];
+		vec3 b[4];
+		float alpha[4];
+
+		for(int l = 0; l < 4; l++)
+		{
+			const vec3_track& track = tracks[i + l];
+			size_t k = find_key(track.times, track.count, t, cursors[i + l]);
+			cursors[i + l] = k;
+
+			a[l] = track.count == 0 ? vec3(0.0f) : track.keys[k];
+			b[l] = track.count < 2 ? a[l] : track.keys[k + 1];
+			alpha[l] = key_alpha(track.times, track.count, k, t);
+		}
+
+		__m128 al = _mm_loadu_ps(alpha);
+		__m128 ax = _mm_setr_ps(a[0].x, a[1].x, a[2].x, a[3].x);
+		__m128 ay = _mm_setr_ps(a[0].y, a[1].y, a[2].y, a[3].y);
+		__m128 az = _mm_setr_ps(a[0].z, a[1].z, a[2].z, a[3].z);
+		__m128 bx = _mm_setr_ps(b[0].x, b[1].x, b[2].x, b[3].x);
+		__m128 by = _mm_setr_ps(b[0].y, b[1].y, b[2].y, b[3].y);
+		__m128 bz = _mm_setr_ps(b[0].z, b[1].z, b[2].z, b[3].z);
+
+		vec4 rx, ry, rz;
+		rx.packed = _mm_add_ps(ax, _mm_mul_ps(_mm_sub_ps(bx, ax), al));
+		ry.packed = _mm_add_ps(ay, _mm_mul_ps(_mm_sub_ps(by, ay), al));
+		rz.packed = _mm_add_ps(az, _mm_mul_ps(_mm_sub_ps(bz, az), al));
+
+		for(int l = 0; l < 4; l++)
+			out[i + l] = vec3(rx.v[l], ry.v[l], rz.v[l]);
+	}
+
+	#endif
+
+	for(; i < n; i++)
+		out[i] = sample_track(tracks[i], t, &cursors[i]);
+}
+
+#if QM_USE_SSE
+
+//slerps 4 SoA quaternions without shortest-path correction:
+inline void slerp_sse(const __m128* q1, const __m128* q2, __m128 a, __m128* out)
+{
+	__m128 cosine = _mm_add_ps(_mm_add_ps(_mm_mul_ps(q1[0], q2[0]), _mm_mul_ps(q1[1], q2[1])),
+	                           _mm_add_ps(_mm_mul_ps(q1[2], q2[2]), _mm_mul_ps(q1[3], q2[3])));
+	__m128 one = _mm_set1_ps(1.0f);
+	cosine = _mm_min_ps(_mm_max_ps(cosine, _mm_set1_ps(-1.0f)), one);
+
+	__m128 angle = acos_sse(cosine);
+	__m128 sine, sine1, sine2, unused;
+	sincos_sse(angle, &sine, &unused);
+	sincos_sse(_mm_mul_ps(_mm_sub_ps(one, a), angle), &sine1, &unused);
+	sincos_sse(_mm_mul_ps(a, angle), &sine2, &unused);
+
+	//fall back to lerp where sin(angle) is too small to divide by:
+	__m128 nearby = _mm_cmpgt_ps(_mm_andnot_ps(_mm_set1_ps(-0.0f), cosine), _mm_set1_ps(0.9995f));
+	__m128 invSine = _mm_div_ps(one, _mm_or_ps(_mm_and_ps(nearby, one), _mm_andnot_ps(nearby, sine)));
+	__m128 w1 = _mm_or_ps(_mm_and_ps(nearby, _mm_sub_ps(one, a)), _mm_andnot_ps(nearby, _mm_mul_ps(sine1, invSine)));
+	__m128 w2 = _mm_or_ps(_mm_and_ps(nearby, a), _mm_andnot_ps(nearby, _mm_mul_ps(sine2, invSine)));
+
+	for(int i = 0; i < 4; i++)
+		out[i] = _mm_add_ps(_mm_mul_ps(q1[i], w1), _mm_mul_ps(q2[i], w2));
+
+	__m128 len = _mm_add_ps(_mm_add_ps(_mm_mul_ps(out[0], out[0]), _mm_mul_ps(out[1], out[1])),
+	                        _mm_add_ps(_mm_mul_ps(out[2], out[2]), _mm_mul_ps(out[3], out[3])));
+	len = _mm_sqrt_ps(len);
+	for(int i = 0; i < 4; i++)
+		out[i] = _mm_div_ps(out[i], len);
+}
+
+#endif
+
+inline void sample_tracks(const quaternion_track* tracks, size_t* cursors, float t, quaternion* out, size_t n, bool useSlerp = false)
+{
+	size_t i = 0;
+
+	#if QM_USE_SSE
+
+	for(; i + 4 <= n; i += 4)
+	{
+		__m128 a[4];
+		__m128 b[4];
+		float alpha[4];
+
+		for(int l = 0; l < 4; l++)
+		{
+			const quaternion_track& track = tracks[i + l];
+			size_t k = find_key(track.times, track.count, t, cursors[i + l]);
+			cursors[i + l] = k;
+
+			a[l] = track.count == 0 ? quaternion_identity().packed : track.keys[k].packed;
+			b[l] = track.count < 2 ? a[l] : track.keys[k + 1].packed;
+			alpha[l] = key_alpha(track.times, track.count, k, t);
+		}
+
+		//transpose to SoA:
+		_MM_TRANSPOSE4_PS(a[0], a[1], a[2], a[3]);
+		_MM_TRANSPOSE4_PS(b[0], b[1], b[2], b[3]);
+
+		//flip the second key into the same hemisphere:
+		__m128 cosine = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a[0], b[0]), _mm_mul_ps(a[1], b[1])),
+		                           _mm_add_ps(_mm_mul_ps(a[2], b[2]), _mm_mul_ps(a[3], b[3])));
+		__m128 sign = _mm_and_ps(cosine, _mm_set1_ps(-0.0f));
+		b[0] = _mm_xor_ps(b[0], sign);
+		b[1] = _mm_xor_ps(b[1], sign);
+		b[2] = _mm_xor_ps(b[2], sign);
+		b[3] = _mm_xor_ps(b[3], sign);
+
+		__m128 w1 = _mm_loadu_ps(alpha);
+		__m128 r[4];
+
+		if(useSlerp)
+			slerp_sse(a, b, w1, r);
+		else
+		{
+			__m128 w0 = _mm_sub_ps(_mm_set1_ps(1.0f), w1);
+			for(int j = 0; j < 4; j++)
+				r[j] = _mm_add_ps(_mm_mul_ps(a[j], w0), _mm_mul_ps(b[j], w1));
+
+			//normalize:
+			__m128 len = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r[0], r[0]), _mm_mul_ps(r[1], r[1])),
+			                        _mm_add_ps(_mm_mul_ps(r[2], r[2]), _mm_mul_ps(r[3], r[3])));
+			len = _mm_sqrt_ps(len);
+			for(int j = 0; j < 4; j++)
+				r[j] = _mm_div_ps(r[j], len);
+		}
+
+		_MM_TRANSPOSE4_PS(r[0], r[1], r[2], r[3]);
+		out[i    ].packed = r[0];
+		out[i + 1].packed = r[1];
+		out[i + 2].packed = r[2];
+		out[i + 3].packed = r[3];
+	}
+
+	#endif
+
+	for(; i < n; i++)
+		out[i] = sample_track(tracks[i], t, &cursors[i], useSlerp);
+}
+
+//pose blending:
+
+//blends numPoses poses of boneCount rotations each by normalized weighted summation
+//every pose is flipped into the hemisphere of the first pose, so when poses are more than 90 degrees apart the
+//result depends on which pose comes first, use blend_poses_accurate() when that matters
+//with no poses every bone is set to the identity
+inline void blend_poses(const quaternion* const* poses, const float* weights, size_t numPoses, quaternion* out, size_t boneCount)
+{
+	if(numPoses == 0)
+	{
+		for(size_t i = 0; i < boneCount; i++)
+			out[i] = quaternion_identity();
+
+		return;
+	}
+
+	size_t i = 0;
+
+	#if QM_USE_SSE
+
+	for(; i + 4 <= boneCount; i += 4)
+	{
+		__m128 r0 = poses[0][i    ].packed;
+		__m128 r1 = poses[0][i + 1].packed;
+		__m128 r2 = poses[0][i + 2].packed;
+		__m128 r3 = poses[0][i + 3].packed;
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+		__m128 w = _mm_set1_ps(weights[0]);
+		__m128 a0 = _mm_mul_ps(r0, w);
+		__m128 a1 = _mm_mul_ps(r1, w);
+		__m128 a2 = _mm_mul_ps(r2, w);
+		__m128 a3 = _mm_mul_ps(r3, w);
+
+		for(size_t k = 1; k < numPoses; k++)
+		{
+			__m128 p0 = poses[k][i    ].packed;
+			__m128 p1 = poses[k][i + 1].packed;
+			__m128 p2 = poses[k][i + 2].packed;
+			__m128 p3 = poses[k][i + 3].packed;
+			_MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+
+			__m128 cosine = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r0, p0), _mm_mul_ps(r1, p1)),
+			                           _mm_add_ps(_mm_mul_ps(r2, p2), _mm_mul_ps(r3, p3)));
+			w = _mm_xor_ps(_mm_set1_ps(weights[k]), _mm_and_ps(cosine, _mm_set1_ps(-0.0f)));
+
+			a0 = _mm_add_ps(a0, _mm_mul_ps(p0, w));
+			a1 = _mm_add_ps(a1, _mm_mul_ps(p1, w));
+			a2 = _mm_add_ps(a2, _mm_mul_ps(p2, w));
+			a3 = _mm_add_ps(a3, _mm_mul_ps(p3, w));
+		}
+
+		__m128 len = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a0, a0), _mm_mul_ps(a1, a1)),
+		                        _mm_add_ps(_mm_mul_ps(a2, a2), _mm_mul_ps(a3, a3)));
+		len = _mm_sqrt_ps(len);
+		a0 = _mm_div_ps(a0, len);
+		a1 = _mm_div_ps(a1, len);
+		a2 = _mm_div_ps(a2, len);
+		a3 = _mm_div_ps(a3, len);
+
+		_MM_TRANSPOSE4_PS(a0, a1, a2, a3);
+		out[i    ].packed = a0;
+		out[i + 1].packed = a1;
+		out[i + 2].packed = a2;
+		out[i + 3].packed = a3;
+	}
+
+	#endif
+
+	for(; i < boneCount; i++)
+	{
+		quaternion ref = poses[0][i];
+		quaternion acc = ref * weights[0];
+
+		for(size_t k = 1; k < numPoses; k++)
+		{
+			quaternion p = poses[k][i];
+			acc = acc + p * (dot(ref, p) < 0.0f ? -weights[k] : weights[k]);
+		}
+
+		out[i] = normalize(acc);
+	}
+}
+
+//blends translations or scales, the weights do not need to sum to 1
+//with no poses every bone is set to zero
+inline void blend_poses(const vec3* const* poses, const float* weights, size_t numPoses, vec3* out, size_t boneCount)
+{
+	if(numPoses == 0)
+	{
+		for(size_t i = 0; i < boneCount; i++)
+			out[i] = vec3(0.0f);
+
+		return;
+	}
+
+	float totalWeight = 0.0f;
+	for(size_t k = 0; k < numPoses; k++)
+		totalWeight += weights[k];
+
+	float invTotal = totalWeight != 0.0f ? 1.0f / totalWeight : 0.0f;
+
+	for(size_t i = 0; i < boneCount; i++)
+	{
+		vec3 acc = poses[0][i] * weights[0];
+		for(size_t k = 1; k < numPoses; k++)
+			acc = acc + poses[k][i] * weights[k];
+
+		out[i] = acc * invTotal;
+	}
+}
+
+//weighted average rotation, computed as the dominant eigenvector of sum(w * q * q^T)
+//more accurate than blend_poses() when the rotations are far apart, intended for small n
+//returns the identity when n is 0
+inline quaternion average(const quaternion* q, const float* weights, size_t n)
+{
+	quaternion result = quaternion_identity();
+	if(n == 0)
+		return result;
+
+	mat4 m;
+	for(size_t i = 0; i < n; i++)
+	{
+		vec4 v = vec4(q[i].x, q[i].y, q[i].z, q[i].w);
+		for(int c = 0; c < 4; c++)
+			m.v[c] = m.v[c] + v * (v.v[c] * weights[i]);
+	}
+
+	//power iteration, starting from the hemisphere-aligned weighted sum:
+	quaternion start = q[0] * weights[0];
+	for(size_t i = 1; i < n; i++)
+		start = start + q[i] * (dot(q[0], q[i]) < 0.0f ? -weights[i] : weights[i]);
+
+	vec4 v = normalize(vec4(start.x, start.y, start.z, start.w));
+	for(int iter = 0; iter < 32; iter++)
+	{
+		vec4 next = m * v;
+		float len = length(next);
+		if(len == 0.0f)
+			break;
+
+		next = next / len;
+		float change = dot(next - v, next - v);
+		v = next;
+
+		if(change < 1e-12f)
+			break;
+	}
+
+	result = quaternion(v.x, v.y, v.z, v.w);
+
+	return result;
+}
+
+//per-bone version of average(), does not depend on the pose order
+//poses beyond the first 16 are gathered into heap scratch space instead of the stack buffer
+inline void blend_poses_accurate(const quaternion* const* poses, const float* weights, size_t numPoses, quaternion* out, size_t boneCount)
+{
+	quaternion localBone[16];
+	quaternion* bone = numPoses <= 16 ? localBone : (quaternion*)QM_MALLOC(numPoses * sizeof(quaternion));
+
+	for(size_t i = 0; i < boneCount; i++)
+	{
+		for(size_t k = 0; k < numPoses; k++)
+			bone[k] = poses[k][i];
+
+		out[i] = average(bone, weights, numPoses);
+	}
+
+	if(bone != localBone)
+		QM_FREE(bone);
+}
+
+//quaternion splines:
+
+//flips each key into the hemisphere of the previous one, as required by the functions below
+inline void align_keys(quaternion* keys, size_t n)
+{
+	for(size_t i = 1; i < n; i++)
+		if(dot(keys[i - 1], keys[i]) < 0.0f)
+			keys[i] = keys[i] * -1.0f;
+}
+
+//computes the squad control point of every key, the end keys are treated as their own neighbors
+inline void squad_controls(const quaternion* keys, quaternion* controls, size_t n)
+{
+	for(size_t i = 0; i < n; i++)
+	{
+		const quaternion& prev = keys[i > 0 ? i - 1 : 0];
+		const quaternion& next = keys[i + 1 < n ? i + 1 : n - 1];
+		controls[i] = squad_control(prev, keys[i], next);
+	}
+}
+
+//evaluates the squad spline through keys (with controls from squad_controls()) at each time ts[0..n)
+//sorted ts are fastest, as the key search is cached between samples
+inline void sample_squad(const float* times, const quaternion* keys, const quaternion* controls, size_t numKeys,
+                         const float* ts, quaternion* out, size_t n)
+{
+	size_t cursor = 0;
+	size_t i = 0;
+
+	if(numKeys < 2)
+	{
+		for(; i < n; i++)
+			out[i] = numKeys == 0 ? quaternion_identity() : keys[0];
+
+		return;
+	}
+
+	#if QM_USE_SSE
+
+	for(; i + 4 <= n; i += 4)
+	{
+		__m128 q1[4], q2[4], s1[4], s2[4];
+		float alpha[4];
+
+		for(int l = 0; l < 4; l++)
+		{
+			size_t k = find_key(times, numKeys, ts[i + l], cursor);
+			cursor = k;
+
+			alpha[l] = key_alpha(times, numKeys, k, ts[i + l]);
+			q1[l] = keys[k].packed;
+			q2[l] = keys[k + 1].packed;
+			s1[l] = controls[k].packed;
+			s2[l] = controls[k + 1].packed;
+		}
+
+		_MM_TRANSPOSE4_PS(q1[0], q1[1], q1[2], q1[3]);
+		_MM_TRANSPOSE4_PS(q2[0], q2[1], q2[2], q2[3]);
+		_MM_TRANSPOSE4_PS(s1[0], s1[1], s1[2], s1[3]);
+		_MM_TRANSPOSE4_PS(s2[0], s2[1], s2[2], s2[3]);
+
+		__m128 a = _mm_loadu_ps(alpha);
+		__m128 outer[4], inner[4], r[4];
+		slerp_sse(q1, q2, a, outer);
+		slerp_sse(s1, s2, a, inner);
+		slerp_sse(outer, inner, _mm_mul_ps(_mm_add_ps(a, a), _mm_sub_ps(_mm_set1_ps(1.0f), a)), r);
+
+		_MM_TRANSPOSE4_PS(r[0], r[1], r[2], r[3]);
+		out[i    ].packed = r[0];
+		out[i + 1].packed = r[1];
+		out[i + 2].packed = r[2];
+		out[i + 3].packed = r[3];
+	}
+
+	#endif
+
+	for(; i < n; i++)
+	{
+		size_t k = find_key(times, numKeys, ts[i], cursor);
+		cursor = k;
+
+		float a = key_alpha(times, numKeys, k, ts[i]);
+		out[i] = squad(keys[k], keys[k + 1], controls[k], controls[k + 1], a);
+	}
+}
+
+//----------------------------------------------------------------------//
+//CURVE FUNCTIONS:
+
+enum curve_type
+{
+	CURVE_BEZIER,      //cubic segments sharing end points: p0 c0 c1 p1 c2 c3 p2 ...
+	CURVE_HERMITE,     //points interleaved with tangents: p0 m0 p1 m1 p2 m2 ...
+	CURVE_CATMULL_ROM  //uniform Catmull-Rom, passes through every point except the first and last
+};
+
+//polynomial coefficients of each basis function, w_j(t) = c[j][0] + c[j][1] t + c[j][2] t^2 + c[j][3] t^3
+static const float curve_coefficients[3][4][4] = {
+	{{1.0f, -3.0f,  3.0f, -1.0f}, {0.0f,  3.0f, -6.0f,  3.0f}, {0.0f, 0.0f,  3.0f, -3.0f}, {0.0f, 0.0f,  0.0f, 1.0f}},
+	{{1.0f,  0.0f, -3.0f,  2.0f}, {0.0f,  1.0f, -2.0f,  1.0f}, {0.0f, 0.0f,  3.0f, -2.0f}, {0.0f, 0.0f, -1.0f, 1.0f}},
+	{{0.0f, -0.5f,  1.0f, -0.5f}, {1.0f,  0.0f, -2.5f,  1.5f}, {0.0f, 0.5f,  2.0f, -1.5f}, {0.0f, 0.0f, -0.5f, 0.5f}}
+};
+
+//the weights of the 4 control points of a segment at t in [0, 1]:
+inline vec4 curve_weights(curve_type type, float t, bool derivative = false)
+{
+	vec4 result;
+
+	const float (*c)[4] = curve_coefficients[type];
+	for(int j = 0; j < 4; j++)
+	{
+		if(derivative)
+			result.v[j] = c[j][1] + t * (2.0f * c[j][2] + t * 3.0f * c[j][3]);
+		else
+			result.v[j] = c[j][0] + t * (c[j][1] + t * (c[j][2] + t * c[j][3]));
+	}
+
+	return result;
+}
+
+#if QM_USE_SSE
+
+//curve_weights() for 4 parameters at once, w[j] holds the weight of control point j in each lane:
+inline void curve_weights_sse(curve_type type, __m128 t, __m128* w, bool derivative = false)
+{
+	const float (*c)[4] = curve_coefficients[type];
+	for(int j = 0; j < 4; j++)
+	{
+		if(derivative)
+		{
+			w[j] = _mm_mul_ps(_mm_mul_ps(t, _mm_set1_ps(3.0f * c[j][3])), t);
+			w[j] = _mm_add_ps(w[j], _mm_mul_ps(t, _mm_set1_ps(2.0f * c[j][2])));
+			w[j] = _mm_add_ps(w[j], _mm_set1_ps(c[j][1]));
+		}
+		else
+		{
+			w[j] = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(c[j][3]), t), _mm_set1_ps(c[j][2]));
+			w[j] = _mm_add_ps(_mm_mul_ps(w[j], t), _mm_set1_ps(c[j][1]));
+			w[j] = _mm_add_ps(_mm_mul_ps(w[j], t), _mm_set1_ps(c[j][0]));
+		}
+	}
+}
+
+#endif
+
+//bezier:
+
+inline vec2 bezier(const vec2& p0, const vec2& p1, const vec2& p2, const vec2& p3, float t)
+{
+	vec4 w = curve_weights(CURVE_BEZIER, t);
+	return p0 * w.x + p1 * w.y + p2 * w.z + p3 * w.w;
+}
+
+inline vec3 bezier(const vec3& p0, const vec3& p1, const vec3& p2, const vec3& p3, float t)
+{
+	vec4 w = curve_weights(CURVE_BEZIER, t);
+	return p0 * w.x + p1 * w.y + p2 * w.z + p3 * w.w;
+}
+
+inline vec4 bezier(const vec4& p0, const vec4& p1, const vec4& p2, const vec4& p3, float t)
+{
+	vec4 w = curve_weights(CURVE_BEZIER, t);
+	return p0 * w.x + p1 * w.y + p2 * w.z + p3 * w.w;
+}
+
+inline vec2 bezier_derivative(const vec2& p0, const vec2& p1, const vec2& p2, const vec2& p3, float t)
+{
+	vec4 w = curve_weights(CURVE_BEZIER, t, true);
+	return p0 * w.x + p1 * w.y + p2 * w.z + p3 * w.w;
+}
+
+inline vec3 bezier_derivative(const vec3& p0, const vec3& p1, const vec3& p2, const vec3& p3, float t)
+{
+	vec4 w = curve_weights(CURVE_BEZIER, t, true);
+	return p0 * w.x + p1 * w.y + p2 * w.z + p3 * w.w;
+}
+
+inline vec4 bezier_derivative(const vec4& p0, const vec4& p1, const vec4& p2, const vec4& p3, float t)
+{
+	vec4 w = curve_weights(CURVE_BEZIER, t, true);
+	return p0 * w.x + p1 * w.y + p2 * w.z + p3 * w.w;
+}
+
+//hermite:
+
+inline vec2 hermite(const vec2& p0, const vec2& m0, const vec2& p1, const vec2& m1, float t)
+{
+	vec4 w = curve_weights(CURVE_HERMITE, t);
+	return p0 * w.x + m0 * w.y + p1 * w.z + m1 * w.w;
+}
+
+inline vec3 hermite(const vec3& p0, const vec3& m0, const vec3& p1, const vec3& m1, float t)
+{
+	vec4 w = curve_weights(CURVE_HERMITE, t);
+	return p0 * w.x + m0 * w.y + p1 * w.z + m1 * w.w;
+}
+
+inline vec4 hermite(const vec4& p0, const vec4& m0, const vec4& p1, const vec4& m1, float t)
+{
+	vec4 w = curve_weights(CURVE_HERMITE, t);
+	return p0 * w.x + m0 * w.y + p1 * w.z + m1 * w.w;
+}
+
+inline vec2 hermite_derivative(const vec2& p0, const vec2& m0, const vec2& p1, const vec2& m1, float t)
+{
+	vec4 w = curve_weights(CURVE_HERMITE, t, true);
+	return p0 * w.x + m0 * w.y + p1 * w.z + m1 * w.w;
+}
+
+inline vec3 hermite_derivative(const vec3& p0, const vec3& m0, const vec3& p1, const vec3& m1, float t)
+{
+	vec4 w = curve_weights(CURVE_HERMITE, t, true);
+	return p0 * w.x + m0 * w.y + p1 * w.z + m1 * w.w;
+}
+
+inline vec4 hermite_derivative(const vec4& p0, const vec4& m0, const vec4& p1, const vec4& m1, float t)
+{
+	vec4 w = curve_weights(CURVE_HERMITE, t, true);
+	return p0 * w.x + m0 * w.y + p1 * w.z + m1 * w.w;
+}
+
+//catmull-rom (the curve runs from p1 to p2):
+
+inline vec2 catmull_rom(const vec2& p0, const vec2& p1, const vec2& p2, const vec2& p3, float t)
+{
+	vec4 w = curve_weights(CURVE_CATMULL_ROM, t);
+	return p0 * w.x + p1 * w.y + p2 * w.z + p3 * w.w;
+}
+
+inline vec3 catmull_rom(const vec3& p0, const vec3& p1, const vec3& p2, const vec3& p3, float t)
+{
+	vec4 w = curve_weights(CURVE_CATMULL_ROM, t);
+	return p0 * w.x + p1 * w.y + p2 * w.z + p3 * w.w;
+}
+
+inline vec4 catmull_rom(const vec4& p0, const vec4& p1, const vec4& p2, const vec4& p3, float t)
+{
+	vec4 w = curve_weights(CURVE_CATMULL_ROM, t);
+	return p0 * w.x + p1 * w.y + p2 * w.z + p3 * w.w;
+}
+
+inline vec2 catmull_rom_derivative(const vec2& p0, const vec2& p1, const vec2& p2, const vec2& p3, float t)
+{
+	vec4 w = curve_weights(CURVE_CATMULL_ROM, t, true);
+	return p0 * w.x + p1 * w.y + p2 * w.z + p3 * w.w;
+}
+
+inline vec3 catmull_rom_derivative(const vec3& p0, const vec3& p1, const vec3& p2, const vec3& p3, float t)
+{
+	vec4 w = curve_weights(CURVE_CATMULL_ROM, t, true);
+	return p0 * w.x + p1 * w.y + p2 * w.z + p3 * w.w;
+}
+
+inline vec4 catmull_rom_derivative(const vec4& p0, const vec4& p1, const vec4& p2, const vec4& p3, float t)
+{
+	vec4 w = curve_weights(CURVE_CATMULL_ROM, t, true);
+	return p0 * w.x + p1 * w.y + p2 * w.z + p3 * w.w;
+}
+
+//a piecewise cubic curve over vec2, vec3 or vec4 control points (which are not owned)
+//parameters run from 0 to num_segments(), with segment i covering [i, i + 1]
+//curves with fewer than 4 control points have no segments and evaluate to their first point (or zero)
+//after build_arc_length_table() the curve can also be sampled by distance along it in O(1)
+template<typename T>
+struct spline
+{
+	curve_type type   = CURVE_CATMULL_ROM;
+	const T*   points = nullptr;
+	size_t     count  = 0;
+
+	float* arcParams   = nullptr; //parameter at each evenly spaced distance
+	size_t arcCount    = 0;
+	float  totalLength = 0.0f;
+
+	spline() {};
+	spline(curve_type _type, const T* _points, size_t _count) { type = _type, points = _points, count = _count; };
+	~spline() { QM_FREE(arcParams); };
+
+	spline(const spline&) = delete;
+	spline& operator=(const spline&) = delete;
+
+	size_t num_segments() const
+	{
+		switch(type)
+		{
+		case CURVE_BEZIER:
+			return count >= 4 ? (count - 1) / 3 : 0;
+		case CURVE_HERMITE:
+			return count >= 4 ? (count - 2) / 2 : 0;
+		default:
+			return count >= 4 ? count - 3 : 0;
+		}
+	};
+
+	//returns the first control point of the segment containing t, and t relative to that segment
+	//returns nullptr when there are fewer than 4 control points:
+	const T* segment(float t, float* local) const
+	{
+		size_t numSegments = num_segments();
+		if(numSegments == 0)
+		{
+			*local = 0.0f;
+			return nullptr;
+		}
+
+		float maxT = (float)numSegments;
+		t = QM_MAX(t, 0.0f);
+		t = QM_MIN(t, maxT);
+
+		size_t seg = (size_t)t;
+		if(seg >= numSegments)
+			seg = numSegments - 1;
+
+		*local = t - (float)seg;
+
+		size_t stride = type == CURVE_BEZIER ? 3 : (type == CURVE_HERMITE ? 2 : 1);
+		return &points[seg * stride];
+	};
+
+	T evaluate(float t, bool derivative = false) const
+	{
+		float u;
+		const T* p = segment(t, &u);
+		if(!p) //degenerate curves are constant, at the first control point if there is one
+			return count > 0 && !derivative ? points[0] : T(0.0f);
+
+		vec4 w = curve_weights(type, u, derivative);
+
+		return p[0] * w.x + p[1] * w.y + p[2] * w.z + p[3] * w.w;
+	};
+
+	T derivative(float t) const
+	{
+		return evaluate(t, true);
+	};
+
+	//evaluates the curve (or its derivative) at ts[0..n), the basis weights are computed 4 at a time:
+	void evaluate(const float* ts, T* out, size_t n, bool derivative = false) const
+	{
+		size_t i = 0;
+
+		#if QM_USE_SSE
+
+		for(; num_segments() > 0 && i + 4 <= n; i += 4)
+		{
+			const T* p[4];
+			vec4 local;
+			for(int l = 0; l < 4; l++)
+				p[l] = segment(ts[i + l], &local.v[l]);
+
+			vec4 w[4];
+			__m128 packed[4];
+			curve_weights_sse(type, local.packed, packed, derivative);
+			for(int j = 0; j < 4; j++)
+				w[j].packed = packed[j];
+
+			for(int l = 0; l < 4; l++)
+				out[i + l] = p[l][0] * w[0].v[l] + p[l][1] * w[1].v[l] + p[l][2] * w[2].v[l] + p[l][3] * w[3].v[l];
+		}
+
+		#endif
+
+		for(; i < n; i++)
+			out[i] = evaluate(ts[i], derivative);
+	};
+
+	//samples the curve numSamples times and builds a table mapping distance to parameter
+	void build_arc_length_table(size_t numSamples)
+	{
+		if(numSamples < 2)
+			numSamples = 2;
+
+		float* lengths = (float*)QM_MALLOC((numSamples + 1) * sizeof(float));
+		float maxT = (float)num_segments();
+
+		T prev = evaluate(0.0f);
+		lengths[0] = 0.0f;
+		for(size_t i = 1; i <= numSamples; i++)
+		{
+			T cur = evaluate(maxT * (float)i / (float)numSamples);
+			lengths[i] = lengths[i - 1] + length(cur - prev);
+			prev = cur;
+		}
+
+		totalLength = lengths[numSamples];
+		arcCount = numSamples + 1;
+		arcParams = (float*)QM_REALLOC(arcParams, arcCount * sizeof(float));
+
+		//invert the cumulative lengths at evenly spaced distances:
+		size_t k = 0;
+		for(size_t j = 0; j < arcCount; j++)
+		{
+			float d = totalLength * (float)j / (float)(arcCount - 1);
+			while(k + 1 < numSamples && lengths[k + 1] < d)
+				k++;
+
+			float segLen = lengths[k + 1] - lengths[k];
+			float a = segLen > 0.0f ? (d - lengths[k]) / segLen : 0.0f;
+			a = QM_MIN(QM_MAX(a, 0.0f), 1.0f);
+
+			arcParams[j] = maxT * ((float)k + a) / (float)numSamples;
+		}
+
+		QM_FREE(lengths);
+	};
+
+	//requires build_arc_length_table():
+	float param_at_distance(float d) const
+	{
+		float f = totalLength > 0.0f ? d / totalLength * (float)(arcCount - 1) : 0.0f;
+		f = QM_MAX(f, 0.0f);
+		f = QM_MIN(f, (float)(arcCount - 1));
+
+		size_t i = (size_t)f;
+		if(i >= arcCount - 1)
+			return arcParams[arcCount - 1];
+
+		float a = f - (float)i;
+		return arcParams[i] + (arcParams[i + 1] - arcParams[i]) * a;
+	};
+
+	T evaluate_at_distance(float d) const
+	{
+		return evaluate(param_at_distance(d));
+	};
+
+	void evaluate_at_distance(const float* ds, T* out, size_t n) const
+	{
+		float ts[64];
+		for(size_t i = 0; i < n; i += 64)
+		{
+			size_t num = QM_MIN(n - i, (size_t)64);
+			for(size_t j = 0; j < num; j++)
+				ts[j] = param_at_distance(ds[i + j]);
+
+			evaluate(ts, &out[i], num);
+		}
+	};
+};
+
+typedef spline<vec2> spline2;
+typedef spline<vec3> spline3;
+typedef spline<vec4> spline4;
+
+//----------------------------------------------------------------------//
+//CAMERA:
+
+//caches the view, projection and view-projection matrices, their inverses and the frustum planes
+//each is recomputed lazily, and only when one of its inputs actually changed
+//view() matches lookat() (or look() after set_direction()) and projection() matches perspective() or orthographic()
+struct camera
+{
+	static const uint8_t VIEW_DIRTY          = 1;
+	static const uint8_t PROJ_DIRTY          = 2;
+	static const uint8_t VIEW_PROJ_DIRTY     = 4;
+	static const uint8_t INV_VIEW_DIRTY      = 8;
+	static const uint8_t INV_PROJ_DIRTY      = 16;
+	static const uint8_t INV_VIEW_PROJ_DIRTY = 32;
+	static const uint8_t PLANES_DIRTY        = 64;
+
+	static const uint8_t VIEW_CHANGED = VIEW_DIRTY | VIEW_PROJ_DIRTY | INV_VIEW_DIRTY | INV_VIEW_PROJ_DIRTY | PLANES_DIRTY;
+	static const uint8_t PROJ_CHANGED = PROJ_DIRTY | VIEW_PROJ_DIRTY | INV_PROJ_DIRTY | INV_VIEW_PROJ_DIRTY | PLANES_DIRTY;
+
+	//inputs:
+	vec3 position  = vec3(0.0f, 0.0f, 0.0f);
+	vec3 target    = vec3(0.0f, 0.0f, -1.0f);
+	vec3 direction = vec3(0.0f, 0.0f, 1.0f);
+	vec3 up        = vec3(0.0f, 1.0f, 0.0f);
+	bool useTarget = true;
+
+	bool  ortho  = false;
+	float fov    = 90.0f;
+	float aspect = 1.0f;
+	float left   = -1.0f, right = 1.0f, bot = -1.0f, top = 1.0f;
+	float near   = 0.1f;
+	float far    = 1000.0f;
+
+	//cached outputs:
+	mutable mat4    viewMat;
+	mutable mat4    projMat;
+	mutable mat4    viewProjMat;
+	mutable mat4    invViewMat;
+	mutable mat4    invProjMat;
+	mutable mat4    invViewProjMat;
+	mutable vec4    planes[6]; //left, right, bottom, top, near, far as (normal, d), dot(normal, p) + d >= 0 inside
+	mutable uint8_t dirty = VIEW_CHANGED | PROJ_CHANGED;
+
+	camera() {};
+
+	void set_position(const vec3& pos)
+	{
+		if(pos == position)
+			return;
+
+		position = pos;
+		dirty |= VIEW_CHANGED;
+	};
+
+	void set_target(const vec3& tgt)
+	{
+		if(useTarget && tgt == target)
+			return;
+
+		target = tgt;
+		useTarget = true;
+		dirty |= VIEW_CHANGED;
+	};
+
+	//same convention as look(), dir points from the target towards the camera
+	//dir is normalized, which look() and the analytic inverse_view() both rely on
+	void set_direction(const vec3& dir)
+	{
+		vec3 unitDir = normalize(dir);
+		if(!useTarget && unitDir == direction)
+			return;
+
+		direction = unitDir;
+		useTarget = false;
+		dirty |= VIEW_CHANGED;
+	};
+
+	void set_up(const vec3& u)
+	{
+		if(u == up)
+			return;
+
+		up = u;
+		dirty |= VIEW_CHANGED;
+	};
+
+	void set_perspective(float _fov, float _aspect, float _near, float _far)
+	{
+		if(!ortho && _fov == fov && _aspect == aspect && _near == near && _far == far)
+			return;
+
+		ortho = false;
+		fov = _fov, aspect = _aspect, near = _near, far = _far;
+		dirty |= PROJ_CHANGED;
+	};
+
+	void set_aspect(float _aspect)
+	{
+		if(_aspect == aspect)
+			return;
+
+		aspect = _aspect;
+		if(!ortho)
+			dirty |= PROJ_CHANGED;
+	};
+
+	void set_orthographic(float _left, float _right, float _bot, float _top, float _near, float _far)
+	{
+		if(ortho && _left == left && _right == right && _bot == bot && _top == top && _near == near && _far == far)
+			return;
+
+		ortho = true;
+		left = _left, right = _right, bot = _bot, top = _top, near = _near, far = _far;
+		dirty |= PROJ_CHANGED;
+	};
+
+	const mat4& view() const
+	{
+		if(dirty & VIEW_DIRTY)
+		{
+			viewMat = useTarget ? lookat(position, target, up) : look(position, direction, up);
+			dirty &= ~VIEW_DIRTY;
+		}
+
+		return viewMat;
+	};
+
+	const mat4& projection() const
+	{
+		if(dirty & PROJ_DIRTY)
+		{
+			projMat = ortho ? orthographic(left, right, bot, top, near, far) : perspective(fov, aspect, near, far);
+			dirty &= ~PROJ_DIRTY;
+		}
+
+		return projMat;
+	};
+
+	const mat4& view_projection() const
+	{
+		if(dirty & VIEW_PROJ_DIRTY)
+		{
+			viewProjMat = projection() * view();
+			dirty &= ~VIEW_PROJ_DIRTY;
+		}
+
+		return viewProjMat;
+	};
+
+	const mat4& inverse_view() const
+	{
+		if(dirty & INV_VIEW_DIRTY)
+		{
+			//the view matrix is a rotation followed by a translation, so invert it analytically:
+			const mat4& v = view();
+			mat4 result = mat4_identity();
+
+			for(int i = 0; i < 3; i++)
+				for(int j = 0; j < 3; j++)
+					result.m[i][j] = v.m[j][i];
+
+			result.m[3][0] = position.x;
+			result.m[3][1] = position.y;
+			result.m[3][2] = position.z;
+
+			invViewMat = result;
+			dirty &= ~INV_VIEW_DIRTY;
+		}
+
+		return invViewMat;
+	};
+
+	const mat4& inverse_projection() const
+	{
+		if(dirty & INV_PROJ_DIRTY)
+		{
+			const mat4& p = projection();
+			mat4 result;
+
+			if(ortho)
+			{
+				result = mat4_identity();
+				for(int i = 0; i < 3; i++)
+				{
+					result.m[i][i] = 1.0f / p.m[i][i];
+					result.m[3][i] = -p.m[3][i] / p.m[i][i];
+				}
+			}
+			else
+			{
+				result.m[0][0] = 1.0f / p.m[0][0];
+				result.m[1][1] = 1.0f / p.m[1][1];
+				result.m[3][2] = -1.0f;
+				result.m[2][3] = 1.0f / p.m[3][2];
+				result.m[3][3] = p.m[2][2] / p.m[3][2];
+			}
+
+			invProjMat = result;
+			dirty &= ~INV_PROJ_DIRTY;
+		}
+
+		return invProjMat;
+	};
+
+	const mat4& inverse_view_projection() const
+	{
+		if(dirty & INV_VIEW_PROJ_DIRTY)
+		{
+			invViewProjMat = inverse_view() * inverse_projection();
+			dirty &= ~INV_VIEW_PROJ_DIRTY;
+		}
+
+		return invViewProjMat;
+	};
+
+	//extracted from the view-projection matrix, normalized:
+	const vec4* frustum_planes() const
+	{
+		if(dirty & PLANES_DIRTY)
+		{
+			mat4 t = transpose(view_projection()); //rows of the view-projection matrix
+
+			planes[0] = t.v[3] + t.v[0];
+			planes[1] = t.v[3] - t.v[0];
+			planes[2] = t.v[3] + t.v[1];
+			planes[3] = t.v[3] - t.v[1];
+			planes[4] = t.v[3] + t.v[2];
+			planes[5] = t.v[3] - t.v[2];
+
+			for(int i = 0; i < 6; i++)
+				planes[i] = planes[i] / length(planes[i].xyz());
+
+			dirty &= ~PLANES_DIRTY;
+		}
+
+		return planes;
+	};
+};
+
+//----------------------------------------------------------------------//
+//PACKET FUNCTIONS:
+
+inline vec3x4 operator+(const vec3x4& v1, const vec3x4& v2)
+{
+	return vec3x4(v1.x + v2.x, v1.y + v2.y, v1.z + v2.z);
+}
+
+inline vec3x4 operator-(const vec3x4& v1, const vec3x4& v2)
+{
+	return vec3x4(v1.x - v2.x, v1.y - v2.y, v1.z - v2.z);
+}
+
+inline vec3x4 operator*(const vec3x4& v1, const vec3x4& v2)
+{
+	return vec3x4(v1.x * v2.x, v1.y * v2.y, v1.z * v2.z);
+}
+
+inline vec3x4 operator*(const vec3x4& v, const vec4& s)
+{
+	return vec3x4(v.x * s, v.y * s, v.z * s);
+}
+
+inline vec4 dot(const vec3x4& v1, const vec3x4& v2)
+{
+	return v1.x * v2.x + v1.y * v2.y + v1.z * v2.z;
+}
+
+inline vec3x4 cross(const vec3x4& v1, const vec3x4& v2)
+{
+	vec3x4 result;
+
+	result.x = (v1.y * v2.z) - (v1.z * v2.y);
+	result.y = (v1.z * v2.x) - (v1.x * v2.z);
+	result.z = (v1.x * v2.y) - (v1.y * v2.x);
+
+	return result;
+}
+
+inline vec3x4 min(const vec3x4& v1, const vec3x4& v2)
+{
+	return vec3x4(min(v1.x, v2.x), min(v1.y, v2.y), min(v1.z, v2.z));
+}
+
+inline vec3x4 max(const vec3x4& v1, const vec3x4& v2)
+{
+	return vec3x4(max(v1.x, v2.x), max(v1.y, v2.y), max(v1.z, v2.z));
+}
+
+inline ray_packet::ray_packet(const vec3x4& _origin, const vec3x4& _dir)
+{
+	origin = _origin;
+	dir = _dir;
+	invDir = vec3x4(1.0f / dir.x, 1.0f / dir.y, 1.0f / dir.z);
+}
+
+inline ray_packet::ray_packet(const vec3* _origins, const vec3* _dirs)
+{
+	origin = vec3x4(_origins[0], _origins[1], _origins[2], _origins[3]);
+	dir = vec3x4(_dirs[0], _dirs[1], _dirs[2], _dirs[3]);
+	invDir = vec3x4(1.0f / dir.x, 1.0f / dir.y, 1.0f / dir.z);
+}
+
+inline triangle4::triangle4(const vec3* _v0, const vec3* _v1, const vec3* _v2)
+{
+	v0 = vec3x4(_v0[0], _v0[1], _v0[2], _v0[3]);
+	e1 = vec3x4(_v1[0], _v1[1], _v1[2], _v1[3]) - v0;
+	e2 = vec3x4(_v2[0], _v2[1], _v2[2], _v2[3]) - v0;
+}
+
+//lane masks (bit i is set if the comparison holds in lane i):
+
+inline int mask_lt(const vec4& v1, const vec4& v2)
+{
+	int result;
+
+	#if QM_USE_SSE
+
+	result = _mm_movemask_ps(_mm_cmplt_ps(v1.packed, v2.packed));
+
+	#else
+
+	result = (v1.x < v2.x) | (v1.y < v2.y) << 1 | (v1.z < v2.z) << 2 | (v1.w < v2.w) << 3;
+
+	#endif
+
+	return result;
+}
+
+inline int mask_le(const vec4& v1, const vec4& v2)
+{
+	int result;
+
+	#if QM_USE_SSE
+
+	result = _mm_movemask_ps(_mm_cmple_ps(v1.packed, v2.packed));
+
+	#else
+
+	result = (v1.x <= v2.x) | (v1.y <= v2.y) << 1 | (v1.z <= v2.z) << 2 | (v1.w <= v2.w) << 3;
+
+	#endif
+
+	return result;
+}
+
+//selects v1 in lanes where the mask bit is set, and v2 elsewhere:
+inline vec4 select(int mask, const vec4& v1, const vec4& v2)
+{
+	vec4 result;
+
+	#if QM_USE_SSE
+
+	__m128i bits = _mm_and_si128(_mm_set1_epi32(mask), _mm_setr_epi32(1, 2, 4, 8));
+	__m128 m = _mm_castsi128_ps(_mm_cmpeq_epi32(bits, _mm_setr_epi32(1, 2, 4, 8)));
+	result.packed = _mm_or_ps(_mm_and_ps(m, v1.packed), _mm_andnot_ps(m, v2.packed));
+
+	#else
+
+	for(int i = 0; i < 4; i++)
+		result.v[i] = (mask >> i) & 1 ? v1.v[i] : v2.v[i];
+
+	#endif
+
+	return result;
+}
+
+inline vec4 abs(const vec4& v)
+{
+	vec4 result;
+
+	#if QM_USE_SSE
+
+	result.packed = _mm_andnot_ps(_mm_set1_ps(-0.0f), v.packed);
+
+	#else
+
+	for(int i = 0; i < 4; i++)
+		result.v[i] = QM_FABSF(v.v[i]);
+
+	#endif
+
+	return result;
+}
+
+inline vec4 sqrt(const vec4& v)
+{
+	vec4 result;
+
+	#if QM_USE_SSE
+
+	result.packed = _mm_sqrt_ps(v.packed);
+
+	#else
+
+	for(int i = 0; i < 4; i++)
+		result.v[i] = QM_SQRTF(v.v[i]);
+
+	#endif
+
+	return result;
+}
+
+//unaligned loads and stores of 4 consecutive floats:
+
+inline vec4 load4(const float* p)
+{
+	vec4 result;
+
+	#if QM_USE_SSE
+
+	result.packed = _mm_loadu_ps(p);
+
+	#else
+
+	result = vec4(p[0], p[1], p[2], p[3]);
+
+	#endif
+
+	return result;
+}
+
+inline void store4(float* p, const vec4& v)
+{
+	#if QM_USE_SSE
+
+	_mm_storeu_ps(p, v.packed);
+
+	#else
+
+	p[0] = v.x;
+	p[1] = v.y;
+	p[2] = v.z;
+	p[3] = v.w;
+
+	#endif
+}
+
+//writes base + i for every set bit i of the mask to out[count...], returns the new count:
+inline size_t append_lanes(int mask, size_t base, uint32_t* out, size_t count)
+{
+	while(mask)
+	{
+		int lane = 0;
+		while(!((mask >> lane) & 1))
+			lane++;
+		mask &= ~(1 << lane);
+
+		out[count++] = (uint32_t)(base + lane);
+	}
+
+	return count;
+}
+
+//ray-box slab tests:
+
+//tests 4 rays against a box, returns the mask of rays that hit it within [0, tMax]
+//the entry distance of each ray is written to tNear (if not nullptr)
+inline int intersect(const ray_packet& rays, const aabb& box, const vec4& tMax, vec4* tNear = nullptr)
+{
+	vec3x4 t1 = (vec3x4(box.min) - rays.origin) * rays.invDir;
+	vec3x4 t2 = (vec3x4(box.max) - rays.origin) * rays.invDir;
+	vec3x4 tSmall = min(t1, t2);
+	vec3x4 tBig   = max(t1, t2);
+
+	vec4 enter = max(max(tSmall.x, tSmall.y), max(tSmall.z, vec4(0.0f)));
+	vec4 exit  = min(min(tBig.x  , tBig.y  ), min(tBig.z  , tMax));
+
+	if(tNear)
+		*tNear = enter;
+
+	return mask_le(enter, exit);
+}
+
+//tests a single ray against 4 boxes, returns the mask of boxes hit within [0, tMax]
+inline int intersect(const vec3& origin, const vec3& invDir, const aabb4& boxes, float tMax, vec4* tNear = nullptr)
+{
+	vec3x4 o  = vec3x4(origin);
+	vec3x4 id = vec3x4(invDir);
+
+	vec3x4 t1 = (boxes.min - o) * id;
+	vec3x4 t2 = (boxes.max - o) * id;
+	vec3x4 tSmall = min(t1, t2);
+	vec3x4 tBig   = max(t1, t2);
+
+	vec4 enter = max(max(tSmall.x, tSmall.y), max(tSmall.z, vec4(0.0f)));
+	vec4 exit  = min(min(tBig.x  , tBig.y  ), min(tBig.z  , vec4(tMax)));
+
+	if(tNear)
+		*tNear = enter;
+
+	return mask_le(enter, exit);
+}
+
+//finds the closest box hit by each ray of the packet, tMax holds the maximum distance of each ray
+//on return tMax holds the entry distance and hitIndex the index of the closest box (-1 if none was hit)
+//returns the mask of rays that hit a box
+inline int intersect(const ray_packet& rays, const aabb* boxes, size_t n, vec4* tMax, int* hitIndex)
+{
+	int result = 0;
+
+	hitIndex[0] = hitIndex[1] = hitIndex[2] = hitIndex[3] = -1;
+
+	for(size_t i = 0; i < n; i++)
+	{
+		vec4 tNear;
+		int hit = intersect(rays, boxes[i], *tMax, &tNear);
+		if(hit == 0)
+			continue;
+
+		*tMax = select(hit, tNear, *tMax);
+		for(int l = 0; l < 4; l++)
+			if((hit >> l) & 1)
+				hitIndex[l] = (int)i;
+
+		result |= hit;
+	}
+
+	return result;
+}
+
+//tests 4 rays against each of n boxes, writing the mask of rays hitting box i to masks[i]
+inline void intersect(const ray_packet& rays, const aabb* boxes, size_t n, const vec4& tMax, int* masks)
+{
+	for(size_t i = 0; i < n; i++)
+		masks[i] = intersect(rays, boxes[i], tMax);
+}
+
+//ray-triangle tests (Moller-Trumbore):
+
+//tests a ray against the triangle (v0, v1, v2), writing the hit distance and barycentrics of v1 and v2 on a hit
+inline bool intersect(const vec3& origin, const vec3& dir, const vec3& v0, const vec3& v1, const vec3& v2, float tMax,
+                      float* t, float* u, float* v)
+{
+	vec3 e1 = v1 - v0;
+	vec3 e2 = v2 - v0;
+
+	vec3 p = cross(dir, e2);
+	float det = dot(e1, p);
+	if(QM_ABS(det) < 1e-12f)
+		return false;
+
+	float invDet = 1.0f / det;
+	vec3 s = origin - v0;
+	float bu = dot(s, p) * invDet;
+	if(bu < 0.0f || bu > 1.0f)
+		return false;
+
+	vec3 q = cross(s, e1);
+	float bv = dot(dir, q) * invDet;
+	if(bv < 0.0f || bu + bv > 1.0f)
+		return false;
+
+	float dist = dot(e2, q) * invDet;
+	if(dist <= 0.0f || dist > tMax)
+		return false;
+
+	*t = dist;
+	*u = bu;
+	*v = bv;
+
+	return true;
+}
+
+//shared by the packet versions, returns the mask of lanes that hit:
+inline int intersect_triangles(const vec3x4& origin, const vec3x4& dir, const vec3x4& v0, const vec3x4& e1, const vec3x4& e2,
+                               const vec4& tMax, vec4* t, vec4* u, vec4* v)
+{
+	vec3x4 p = cross(dir, e2);
+	vec4 det = dot(e1, p);
+	vec4 invDet = 1.0f / det;
+
+	vec3x4 s = origin - v0;
+	vec4 bu = dot(s, p) * invDet;
+	vec3x4 q = cross(s, e1);
+	vec4 bv = dot(dir, q) * invDet;
+	vec4 dist = dot(e2, q) * invDet;
+
+	vec4 zero = vec4(0.0f);
+	int result = mask_lt(vec4(1e-24f), det * det);
+	result &= mask_le(zero, bu);
+	result &= mask_le(zero, bv);
+	result &= mask_le(bu + bv, vec4(1.0f));
+	result &= mask_lt(zero, dist);
+	result &= mask_le(dist, tMax);
+
+	*t = dist;
+	*u = bu;
+	*v = bv;
+
+	return result;
+}
+
+//tests a single ray against 4 triangles, returns the mask of triangles hit within tMax
+inline int intersect(const vec3& origin, const vec3& dir, const triangle4& tris, float tMax, vec4* t, vec4* u, vec4* v)
+{
+	return intersect_triangles(vec3x4(origin), vec3x4(dir), tris.v0, tris.e1, tris.e2, vec4(tMax), t, u, v);
+}
+
+//tests 4 rays against a single triangle, returns the mask of rays that hit it within tMax
+inline int intersect(const ray_packet& rays, const vec3& v0, const vec3& v1, const vec3& v2, const vec4& tMax, vec4* t, vec4* u, vec4* v)
+{
+	return intersect_triangles(rays.origin, rays.dir, vec3x4(v0), vec3x4(v1 - v0), vec3x4(v2 - v0), tMax, t, u, v);
+}
+
+//finds the closest of 4 * n triangles hit by a ray, returns its index (4 * i + lane) or -1 if none was hit
+//tMax is updated to the hit distance
+inline int intersect(const vec3& origin, const vec3& dir, const triangle4* tris, size_t n, float* tMax, float* u, float* v)
+{
+	int result = -1;
+
+	vec3x4 o = vec3x4(origin);
+	vec3x4 d = vec3x4(dir);
+
+	for(size_t i = 0; i < n; i++)
+	{
+		vec4 t4, u4, v4;
+		int hit = intersect_triangles(o, d, tris[i].v0, tris[i].e1, tris[i].e2, vec4(*tMax), &t4, &u4, &v4);
+
+		while(hit)
+		{
+			int lane = 0;
+			while(!((hit >> lane) & 1))
+				lane++;
+			hit &= ~(1 << lane);
+
+			if(t4.v[lane] <= *tMax)
+			{
+				*tMax = t4.v[lane];
+				*u = u4.v[lane];
+				*v = v4.v[lane];
+				result = (int)(i * 4) + lane;
+			}
+		}
+	}
+
+	return result;
+}
+
+//----------------------------------------------------------------------//
+//BOUNDING BOX FUNCTIONS:
+
+inline aabb merge(const aabb& b1, const aabb& b2)
+{
+	return aabb(min(b1.min, b2.min), max(b1.max, b2.max));
+}
+
+inline aabb merge(const aabb& b, const vec3& p)
+{
+	return aabb(min(b.min, p), max(b.max, p));
+}
+
+inline float surface_area(const aabb& b)
+{
+	vec3 e = b.max - b.min;
+	return 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+}
+
+inline bool overlap(const aabb& b1, const aabb& b2)
+{
+	return b1.min.x <= b2.max.x && b2.min.x <= b1.max.x &&
+	       b1.min.y <= b2.max.y && b2.min.y <= b1.max.y &&
+	       b1.min.z <= b2.max.z && b2.min.z <= b1.max.z;
+}
+
+//squared distance from a point to a box, 0 if the point is inside:
+inline float distance_squared(const aabb& b, const vec3& p)
+{
+	vec3 d = max(max(b.min - p, p - b.max), vec3(0.0f));
+	return dot(d, d);
+}
+
+//scalar slab test, returns whether the ray hits the box within [0, tMax]:
+inline bool intersect(const vec3& origin, const vec3& invDir, const aabb& box, float tMax, float* tNear = nullptr)
+{
+	vec3 t1 = (box.min - origin) * invDir;
+	vec3 t2 = (box.max - origin) * invDir;
+	vec3 tSmall = min(t1, t2);
+	vec3 tBig   = max(t1, t2);
+
+	float enter = QM_MAX(QM_MAX(tSmall.x, tSmall.y), QM_MAX(tSmall.z, 0.0f));
+	float exit  = QM_MIN(QM_MIN(tBig.x  , tBig.y  ), QM_MIN(tBig.z  , tMax));
+
+	if(tNear)
+		*tNear = enter;
+
+	return enter <= exit;
+}
+
+inline aabb lane(const aabb4& b, size_t i)
+{
+	return aabb(b.min.lane(i), b.max.lane(i));
+}
+
+inline void set_lane(aabb4& b, size_t i, const aabb& val)
+{
+	b.min.x.v[i] = val.min.x; b.min.y.v[i] = val.min.y; b.min.z.v[i] = val.min.z;
+	b.max.x.v[i] = val.max.x; b.max.y.v[i] = val.max.y; b.max.z.v[i] = val.max.z;
+}
+
+//closest point on the triangle (a, b, c) to p:
+inline vec3 closest_point_on_triangle(const vec3& p, const vec3& a, const vec3& b, const vec3& c)
+{
+	vec3 ab = b - a;
+	vec3 ac = c - a;
+	vec3 ap = p - a;
+
+	float d1 = dot(ab, ap);
+	float d2 = dot(ac, ap);
+	if(d1 <= 0.0f && d2 <= 0.0f)
+		return a;
+
+	vec3 bp = p - b;
+	float d3 = dot(ab, bp);
+	float d4 = dot(ac, bp);
+	if(d3 >= 0.0f && d4 <= d3)
+		return b;
+
+	float vc = d1 * d4 - d3 * d2;
+	if(vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+		return a + ab * (d1 / (d1 - d3));
+
+	vec3 cp = p - c;
+	float d5 = dot(ab, cp);
+	float d6 = dot(ac, cp);
+	if(d6 >= 0.0f && d5 <= d6)
+		return c;
+
+	float vb = d5 * d2 - d1 * d6;
+	if(vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+		return a + ac * (d2 / (d2 - d6));
+
+	float va = d3 * d6 - d5 * d4;
+	if(va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+		return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+	float denom = 1.0f / (va + vb + vc);
+	return a + ab * (vb * denom) + ac * (vc * denom);
+}
+
+//----------------------------------------------------------------------//
+//BVH:
+
+struct bvh_node
+{
+	aabb4 bounds;
+	int   children[4]; //index of a child node or of the first primitive of a leaf in bvh::prims, -1 for empty slots
+	int   counts[4];   //number of primitives in a leaf, 0 for child nodes and empty slots
+};
+
+//a 4-wide bounding volume hierarchy over boxes or triangles, built with binned SAH
+//each node stores the boxes of its 4 children as SoA, so they are tested against a query at once
+//nodes are stored parent-first, with node 0 as the root
+struct bvh
+{
+	static const int NUM_BINS    = 16;
+	static const int STACK_SIZE  = 256; //traversal stack kept on the stack, deeper trees allocate one
+
+	bvh_node* nodes        = nullptr;
+	size_t    numNodes     = 0;
+	size_t    nodeCapacity = 0;
+	uint32_t  maxDepth     = 0; //levels of interior nodes, each level adds at most 3 pending nodes to a traversal
+
+	uint32_t* prims     = nullptr; //primitive indices, each leaf references a range
+	aabb*     primBoxes = nullptr; //indexed by primitive index
+	size_t    numPrims  = 0;
+
+	//when built over triangles (not owned):
+	const vec3*     vertices = nullptr;
+	const uint32_t* indices  = nullptr;
+
+	int maxLeafSize = 4;
+
+	bvh() {};
+	~bvh()
+	{
+		QM_FREE(nodes);
+		QM_FREE(prims);
+		QM_FREE(primBoxes);
+	};
+
+	bvh(const bvh&) = delete;
+	bvh& operator=(const bvh&) = delete;
+
+	void build(const aabb* boxes, size_t n)
+	{
+		vertices = nullptr;
+		indices  = nullptr;
+
+		init(n);
+		for(size_t i = 0; i < n; i++)
+			primBoxes[i] = boxes[i];
+
+		build_nodes();
+	};
+
+	//builds over triangles made of 3 vertices each, either listed by indices or consecutive if indices is nullptr
+	//the vertices are referenced, not copied
+	void build(const vec3* _vertices, const uint32_t* _indices, size_t numTriangles)
+	{
+		vertices = _vertices;
+		indices  = _indices;
+
+		init(numTriangles);
+		triangle_boxes();
+
+		build_nodes();
+	};
+
+	//updates the node bounds after the primitives moved, keeping the tree structure
+	void refit(const aabb* boxes)
+	{
+		for(size_t i = 0; i < numPrims; i++)
+			primBoxes[i] = boxes[i];
+
+		refit_nodes();
+	};
+
+	//for triangle hierarchies, after the referenced vertices changed
+	void refit()
+	{
+		triangle_boxes();
+		refit_nodes();
+	};
+
+	void triangle(uint32_t prim, vec3* a, vec3* b, vec3* c) const
+	{
+		uint32_t i = prim * 3;
+		*a = vertices[indices ? indices[i    ] : i    ];
+		*b = vertices[indices ? indices[i + 1] : i + 1];
+		*c = vertices[indices ? indices[i + 2] : i + 2];
+	};
+
+	//returns the closest primitive hit by the ray (its box, or the triangle itself), or -1
+	//tMax is updated to the hit distance, u and v receive the barycentrics of triangle hits
+	int raycast(const vec3& origin, const vec3& dir, float* tMax, float* u = nullptr, float* v = nullptr) const
+	{
+		int result = -1;
+		if(numNodes == 0)
+			return result;
+
+		vec3 invDir = 1.0f / dir;
+
+		int localStack[STACK_SIZE];
+		int* stack = traversal_stack(localStack);
+		int sp = 0;
+		stack[sp++] = 0;
+
+		while(sp > 0)
+		{
+			const bvh_node& node = nodes[stack[--sp]];
+
+			vec4 tNear;
+			int hit = intersect(origin, invDir, node.bounds, *tMax, &tNear);
+
+			int order[4];
+			int numOrder = 0;
+
+			for(int i = 0; i < 4; i++)
+			{
+				if(!((hit >> i) & 1) || node.children[i] < 0)
+					continue;
+
+				if(node.counts[i] == 0)
+				{
+					order[numOrder++] = i;
+					continue;
+				}
+
+				for(int k = 0; k < node.counts[i]; k++)
+				{
+					uint32_t prim = prims[node.children[i] + k];
+
+					if(vertices)
+					{
+						vec3 a, b, c;
+						float t, bu, bv;
+						triangle(prim, &a, &b, &c);
+
+						if(intersect(origin, dir, a, b, c, *tMax, &t, &bu, &bv))
+						{
+							*tMax = t;
+							if(u) *u = bu;
+							if(v) *v = bv;
+							result = (int)prim;
+						}
+					}
+					else
+					{
+						float t;
+						if(intersect(origin, invDir, primBoxes[prim], *tMax, &t))
+						{
+							*tMax = t;
+							result = (int)prim;
+						}
+					}
+				}
+			}
+
+			//push far children first so the nearest is visited next:
+			sort_lanes(order, numOrder, tNear);
+			for(int i = numOrder - 1; i >= 0; i--)
+				stack[sp++] = node.children[order[i]];
+		}
+
+		if(stack != localStack)
+			QM_FREE(stack);
+
+		return result;
+	};
+
+	//finds every primitive whose box overlaps the given box, writing up to maxOut of their indices to out
+	//returns the total number found
+	size_t overlap(const aabb& box, uint32_t* out, size_t maxOut) const
+	{
+		size_t result = 0;
+		if(numNodes == 0)
+			return result;
+
+		vec3x4 boxMin = vec3x4(box.min);
+		vec3x4 boxMax = vec3x4(box.max);
+
+		int localStack[STACK_SIZE];
+		int* stack = traversal_stack(localStack);
+		int sp = 0;
+		stack[sp++] = 0;
+
+		while(sp > 0)
+		{
+			const bvh_node& node = nodes[stack[--sp]];
+
+			int hit = mask_le(node.bounds.min.x, boxMax.x) & mask_le(boxMin.x, node.bounds.max.x) &
+			          mask_le(node.bounds.min.y, boxMax.y) & mask_le(boxMin.y, node.bounds.max.y) &
+			          mask_le(node.bounds.min.z, boxMax.z) & mask_le(boxMin.z, node.bounds.max.z);
+
+			for(int i = 0; i < 4; i++)
+			{
+				if(!((hit >> i) & 1) || node.children[i] < 0)
+					continue;
+
+				if(node.counts[i] == 0)
+				{
+					stack[sp++] = node.children[i];
+					continue;
+				}
+
+				for(int k = 0; k < node.counts[i]; k++)
+				{
+					uint32_t prim = prims[node.children[i] + k];
+					if(qm::overlap(primBoxes[prim], box))
+					{
+						if(result < maxOut)
+							out[result] = prim;
+
+						result++;
+					}
+				}
+			}
+		}
+
+		if(stack != localStack)
+			QM_FREE(stack);
+
+		return result;
+	};
+
+	//returns the primitive closest to p (by its box, or the triangle itself), or -1 if none is within sqrt(*distSq)
+	//distSq is updated to the squared distance of the result
+	int nearest(const vec3& p, float* distSq) const
+	{
+		int result = -1;
+		if(numNodes == 0)
+			return result;
+
+		vec3x4 point = vec3x4(p);
+
+		int localStack[STACK_SIZE];
+		int* stack = traversal_stack(localStack);
+		int sp = 0;
+		stack[sp++] = 0;
+
+		while(sp > 0)
+		{
+			const bvh_node& node = nodes[stack[--sp]];
+
+			//squared distance to each child box:
+			vec3x4 d = max(max(node.bounds.min - point, point - node.bounds.max), vec3x4(vec3(0.0f)));
+			vec4 dist = dot(d, d);
+			int hit = mask_le(dist, vec4(*distSq));
+
+			int order[4];
+			int numOrder = 0;
+
+			for(int i = 0; i < 4; i++)
+			{
+				if(!((hit >> i) & 1) || node.children[i] < 0)
+					continue;
+
+				if(node.counts[i] == 0)
+				{
+					order[numOrder++] = i;
+					continue;
+				}
+
+				for(int k = 0; k < node.counts[i]; k++)
+				{
+					uint32_t prim = prims[node.children[i] + k];
+
+					float primDist;
+					if(vertices)
+					{
+						vec3 a, b, c;
+						triangle(prim, &a, &b, &c);
+
+						vec3 to = closest_point_on_triangle(p, a, b, c) - p;
+						primDist = dot(to, to);
+					}
+					else
+						primDist = distance_squared(primBoxes[prim], p);
+
+					if(primDist <= *distSq)
+					{
+						*distSq = primDist;
+						result = (int)prim;
+					}
+				}
+			}
+
+			sort_lanes(order, numOrder, dist);
+			for(int i = numOrder - 1; i >= 0; i--)
+				stack[sp++] = node.children[order[i]];
+		}
+
+		if(stack != localStack)
+			QM_FREE(stack);
+
+		return result;
+	};
+
+private:
+	void init(size_t n)
+	{
+		numPrims = n;
+		numNodes = 0;
+		prims     = (uint32_t*)QM_REALLOC(prims    , n * sizeof(uint32_t));
+		primBoxes = (aabb*)    QM_REALLOC(primBoxes, n * sizeof(aabb));
+
+		for(size_t i = 0; i < n; i++)
+			prims[i] = (uint32_t)i;
+	};
+
+	void triangle_boxes()
+	{
+		for(size_t i = 0; i < numPrims; i++)
+		{
+			vec3 a, b, c;
+			triangle((uint32_t)i, &a, &b, &c);
+			primBoxes[i] = aabb(min(min(a, b), c), max(max(a, b), c));
+		}
+	};
+
+	//returns local if it can hold every node pending during a traversal, or a heap allocation otherwise
+	int* traversal_stack(int* local) const
+	{
+		size_t size = 3 * (size_t)maxDepth + 1;
+		return size <= (size_t)STACK_SIZE ? local : (int*)QM_MALLOC(size * sizeof(int));
+	};
+
+	//sorts the lane indices in order[] by increasing key:
+	static void sort_lanes(int* order, int n, const vec4& key)
+	{
+		for(int i = 1; i < n; i++)
+			for(int j = i; j > 0 && key.v[order[j]] < key.v[order[j - 1]]; j--)
+			{
+				int tmp = order[j];
+				order[j] = order[j - 1];
+				order[j - 1] = tmp;
+			}
+	};
+
+	int alloc_node()
+	{
+		if(numNodes == nodeCapacity)
+		{
+			nodeCapacity = nodeCapacity < 16 ? 16 : nodeCapacity * 2;
+			nodes = (bvh_node*)QM_REALLOC(nodes, nodeCapacity * sizeof(bvh_node));
+		}
+
+		bvh_node& node = nodes[numNodes];
+		node = bvh_node();
+		for(int i = 0; i < 4; i++)
+		{
+			node.children[i] = -1;
+			node.counts[i] = 0;
+		}
+
+		return (int)numNodes++;
+	};
+
+	aabb range_bounds(uint32_t begin, uint32_t end) const
+	{
+		aabb result;
+		for(uint32_t i = begin; i < end; i++)
+			result = merge(result, primBoxes[prims[i]]);
+
+		return result;
+	};
+
+	//binned SAH split of prims[begin..end), returns false if all centroids coincide
+	bool split(uint32_t begin, uint32_t end, uint32_t* mid) const
+	{
+		aabb centroidBounds;
+		for(uint32_t i = begin; i < end; i++)
+		{
+			const aabb& b = primBoxes[prims[i]];
+			centroidBounds = merge(centroidBounds, (b.min + b.max) * 0.5f);
+		}
+
+		vec3 extent = centroidBounds.max - centroidBounds.min;
+		int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+		if(extent.v[axis] <= 0.0f)
+			return false;
+
+		float offset = centroidBounds.min.v[axis];
+		float scale = (float)NUM_BINS * 0.9999f / extent.v[axis];
+
+		aabb binBoxes[NUM_BINS];
+		uint32_t binCounts[NUM_BINS] = {};
+		for(uint32_t i = begin; i < end; i++)
+		{
+			const aabb& b = primBoxes[prims[i]];
+			int bin = (int)(((b.min.v[axis] + b.max.v[axis]) * 0.5f - offset) * scale);
+			bin = QM_MIN(QM_MAX(bin, 0), NUM_BINS - 1);
+
+			binBoxes[bin] = merge(binBoxes[bin], b);
+			binCounts[bin]++;
+		}
+
+		//sweep from both sides to find the cheapest split:
+		float leftCost[NUM_BINS - 1];
+		aabb acc;
+		uint32_t count = 0;
+		for(int i = 0; i < NUM_BINS - 1; i++)
+		{
+			acc = merge(acc, binBoxes[i]);
+			count += binCounts[i];
+			leftCost[i] = count > 0 ? surface_area(acc) * (float)count : 0.0f;
+		}
+
+		int bestBin = 0;
+		float bestCost = INFINITY;
+		acc = aabb();
+		count = 0;
+		for(int i = NUM_BINS - 1; i > 0; i--)
+		{
+			acc = merge(acc, binBoxes[i]);
+			count += binCounts[i];
+
+			float cost = leftCost[i - 1] + (count > 0 ? surface_area(acc) * (float)count : 0.0f);
+			if(cost < bestCost)
+			{
+				bestCost = cost;
+				bestBin = i - 1;
+			}
+		}
+
+		//partition:
+		uint32_t i = begin;
+		uint32_t j = end;
+		while(i < j)
+		{
+			const aabb& b = primBoxes[prims[i]];
+			int bin = (int)(((b.min.v[axis] + b.max.v[axis]) * 0.5f - offset) * scale);
+			if(bin <= bestBin)
+				i++;
+			else
+			{
+				j--;
+				uint32_t tmp = prims[i];
+				prims[i] = prims[j];
+				prims[j] = tmp;
+			}
+		}
+
+		*mid = i;
+		if(*mid == begin || *mid == end)
+			*mid = (begin + end) / 2;
+
+		return true;
+	};
+
+	int build_node(uint32_t begin, uint32_t end, uint32_t depth)
+	{
+		int index = alloc_node();
+		maxDepth = QM_MAX(maxDepth, depth);
+
+		//split the range into up to 4 children, always splitting the largest one:
+		uint32_t rangeBegin[4] = {begin};
+		uint32_t rangeEnd[4] = {end};
+		bool leaf[4] = {};
+		int numRanges = 1;
+
+		while(numRanges < 4)
+		{
+			int pick = -1;
+			uint32_t largest = (uint32_t)maxLeafSize;
+			for(int i = 0; i < numRanges; i++)
+				if(!leaf[i] && rangeEnd[i] - rangeBegin[i] > largest)
+				{
+					pick = i;
+					largest = rangeEnd[i] - rangeBegin[i];
+				}
+
+			if(pick < 0)
+				break;
+
+			uint32_t mid;
+			if(!split(rangeBegin[pick], rangeEnd[pick], &mid))
+			{
+				leaf[pick] = true;
+				continue;
+			}
+
+			rangeBegin[numRanges] = mid;
+			rangeEnd[numRanges] = rangeEnd[pick];
+			rangeEnd[pick] = mid;
+			numRanges++;
+		}
+
+		for(int i = 0; i < numRanges; i++)
+		{
+			uint32_t count = rangeEnd[i] - rangeBegin[i];
+			int child;
+			int childCount;
+
+			if(leaf[i] || count <= (uint32_t)maxLeafSize)
+			{
+				child = (int)rangeBegin[i];
+				childCount = (int)count;
+			}
+			else
+			{
+				child = build_node(rangeBegin[i], rangeEnd[i], depth + 1);
+				childCount = 0;
+			}
+
+			bvh_node& node = nodes[index]; //may have moved during recursion
+			node.children[i] = child;
+			node.counts[i] = childCount;
+			set_lane(node.bounds, i, range_bounds(rangeBegin[i], rangeEnd[i]));
+		}
+
+		return index;
+	};
+
+	void build_nodes()
+	{
+		maxDepth = 0;
+		if(numPrims > 0)
+			build_node(0, (uint32_t)numPrims, 1);
+	};
+
+	void refit_nodes()
+	{
+		//children are always stored after their parents:
+		for(size_t n = numNodes; n-- > 0;)
+		{
+			bvh_node& node = nodes[n];
+			for(int i = 0; i < 4; i++)
+			{
+				if(node.children[i] < 0)
+					continue;
+
+				aabb box;
+				if(node.counts[i] > 0)
+					box = range_bounds((uint32_t)node.children[i], (uint32_t)(node.children[i] + node.counts[i]));
+				else
+				{
+					const bvh_node& child = nodes[node.children[i]];
+					for(int j = 0; j < 4; j++)
+						if(child.children[j] >= 0)
+							box = merge(box, lane(child.bounds, j));
+				}
+
+				set_lane(node.bounds, i, box);
+			}
+		}
+	};
+};
+
+//----------------------------------------------------------------------//
+//SPATIAL GRID:
+
+//a uniform grid over points, hashed into a table of buckets
+//points are counting-sorted by bucket and stored as SoA so radius queries test 4 at a time
+struct spatial_grid
+{
+	float  cellSize    = 1.0f;
+	float  invCellSize = 1.0f;
+
+	size_t    numBuckets  = 0;       //always a power of 2
+	uint32_t* bucketStart = nullptr; //numBuckets + 1 offsets into the sorted arrays
+
+	size_t    numPoints = 0;
+	float*    xs        = nullptr;   //sorted positions, padded with 3 extra INFINITY entries
+	float*    ys        = nullptr;
+	float*    zs        = nullptr;
+	uint32_t* indices   = nullptr;   //original index of each sorted point
+
+	spatial_grid() {};
+	~spatial_grid()
+	{
+		QM_FREE(bucketStart);
+		QM_FREE(xs);
+		QM_FREE(ys);
+		QM_FREE(zs);
+		QM_FREE(indices);
+	};
+
+	spatial_grid(const spatial_grid&) = delete;
+	spatial_grid& operator=(const spatial_grid&) = delete;
+
+	//cellSize should be about the typical query radius
+	void build(const vec3* positions, size_t n, float _cellSize)
+	{
+		cellSize = _cellSize;
+		invCellSize = 1.0f / _cellSize;
+		numPoints = n;
+
+		//queries on an empty grid return before touching the buckets:
+		if(n == 0)
+			return;
+
+		size_t buckets = 16;
+		while(buckets < n)
+			buckets *= 2;
+
+		if(buckets != numBuckets)
+		{
+			numBuckets = buckets;
+			bucketStart = (uint32_t*)QM_REALLOC(bucketStart, (numBuckets + 1) * sizeof(uint32_t));
+		}
+
+		size_t padded = n + 3; //buckets start anywhere, so a 4-wide load may run 3 past the end
+		xs      = (float*)   QM_REALLOC(xs     , padded * sizeof(float));
+		ys      = (float*)   QM_REALLOC(ys     , padded * sizeof(float));
+		zs      = (float*)   QM_REALLOC(zs     , padded * sizeof(float));
+		indices = (uint32_t*)QM_REALLOC(indices, padded * sizeof(uint32_t));
+
+		//count:
+		uint32_t* pointBuckets = (uint32_t*)QM_MALLOC(n * sizeof(uint32_t));
+		for(size_t i = 0; i <= numBuckets; i++)
+			bucketStart[i] = 0;
+
+		for(size_t i = 0; i < n; i++)
+		{
+			pointBuckets[i] = bucket(positions[i]);
+			bucketStart[pointBuckets[i] + 1]++;
+		}
+
+		for(size_t i = 0; i < numBuckets; i++)
+			bucketStart[i + 1] += bucketStart[i];
+
+		//scatter, advancing each bucket's start to its end:
+		for(size_t i = 0; i < n; i++)
+		{
+			uint32_t dst = bucketStart[pointBuckets[i]]++;
+
+			xs[dst] = positions[i].x;
+			ys[dst] = positions[i].y;
+			zs[dst] = positions[i].z;
+			indices[dst] = (uint32_t)i;
+		}
+
+		QM_FREE(pointBuckets);
+
+		//shift back so bucketStart holds the starts again:
+		for(size_t i = numBuckets; i > 0; i--)
+			bucketStart[i] = bucketStart[i - 1];
+		bucketStart[0] = 0;
+
+		for(size_t i = n; i < padded; i++)
+		{
+			xs[i] = INFINITY;
+			ys[i] = INFINITY;
+			zs[i] = INFINITY;
+			indices[i] = 0;
+		}
+	};
+
+	//writes the indices of up to maxOut points within radius of center to out, returns the total number found
+	size_t query_radius(const vec3& center, float radius, uint32_t* out, size_t maxOut) const
+	{
+		size_t result = 0;
+		if(numPoints == 0)
+			return result;
+
+		float minCell[3];
+		float maxCell[3];
+		float numCells = 1.0f;
+		for(int i = 0; i < 3; i++)
+		{
+			minCell[i] = QM_FLOORF((center.v[i] - radius) * invCellSize);
+			maxCell[i] = QM_FLOORF((center.v[i] + radius) * invCellSize);
+			numCells *= maxCell[i] - minCell[i] + 1.0f;
+		}
+
+		//large queries (including infinite or NaN radii) just scan every point:
+		if(!(numCells < (float)numBuckets))
+			return filter(0, (uint32_t)numPoints, center, radius, out, maxOut, result);
+
+		int32_t lo[3] = {cell(minCell[0]), cell(minCell[1]), cell(minCell[2])};
+		int32_t hi[3] = {cell(maxCell[0]), cell(maxCell[1]), cell(maxCell[2])};
+
+		//different cells can hash to the same bucket, so the bucket ids are collected, sorted and
+		//each visited once, the scratch space is per call so concurrent queries are safe:
+		size_t count = (size_t)(hi[0] - lo[0] + 1) * (size_t)(hi[1] - lo[1] + 1) * (size_t)(hi[2] - lo[2] + 1);
+
+		uint32_t localBuckets[64];
+		uint32_t* buckets = count <= 64 ? localBuckets : (uint32_t*)QM_MALLOC(count * sizeof(uint32_t));
+		size_t numCellBuckets = 0;
+
+		for(int32_t z = lo[2]; z <= hi[2]; z++)
+		for(int32_t y = lo[1]; y <= hi[1]; y++)
+		for(int32_t x = lo[0]; x <= hi[0]; x++)
+			buckets[numCellBuckets++] = hash(x, y, z);
+
+		sort_buckets(buckets, numCellBuckets);
+
+		for(size_t i = 0; i < numCellBuckets; i++)
+		{
+			uint32_t b = buckets[i];
+			if(i > 0 && b == buckets[i - 1])
+				continue;
+
+			result = filter(bucketStart[b], bucketStart[b + 1], center, radius, out, maxOut, result);
+		}
+
+		if(buckets != localBuckets)
+			QM_FREE(buckets);
+
+		return result;
+	};
+
+	uint32_t bucket(const vec3& p) const
+	{
+		return hash(cell(QM_FLOORF(p.x * invCellSize)),
+		            cell(QM_FLOORF(p.y * invCellSize)),
+		            cell(QM_FLOORF(p.z * invCellSize)));
+	};
+
+private:
+	//clamps a floored cell coordinate into int32_t range before converting it (NaN maps to the lower bound)
+	//far away points share the boundary cells, which stays correct since every candidate is distance-tested
+	static int32_t cell(float f)
+	{
+		f = QM_MAX(f, -1073741824.0f);
+		f = QM_MIN(f,  1073741824.0f);
+		return (int32_t)f;
+	};
+
+	//in-place heap sort, O(n log n) without any scratch space:
+	static void sort_buckets(uint32_t* a, size_t n)
+	{
+		for(size_t i = n / 2; i-- > 0;)
+			sift_down(a, i, n);
+
+		//repeatedly move the largest remaining id to the end:
+		for(size_t end = n; end-- > 1;)
+		{
+			uint32_t tmp = a[0];
+			a[0] = a[end];
+			a[end] = tmp;
+			sift_down(a, 0, end);
+		}
+	};
+
+	static void sift_down(uint32_t* a, size_t i, size_t n)
+	{
+		for(size_t child = 2 * i + 1; child < n; child = 2 * i + 1)
+		{
+			if(child + 1 < n && a[child + 1] > a[child])
+				child++;
+
+			if(a[i] >= a[child])
+				break;
+
+			uint32_t tmp = a[i];
+			a[i] = a[child];
+			a[child] = tmp;
+			i = child;
+		}
+	};
+
+	uint32_t hash(int32_t x, int32_t y, int32_t z) const
+	{
+		return (((uint32_t)x * 73856093u) ^ ((uint32_t)y * 19349663u) ^ ((uint32_t)z * 83492791u)) & (uint32_t)(numBuckets - 1);
+	};
+
+	//appends the points in sorted range [begin, end) that are within radius of center:
+	size_t filter(uint32_t begin, uint32_t end, const vec3& center, float radius, uint32_t* out, size_t maxOut, size_t count) const
+	{
+		vec4 cx = vec4(center.x);
+		vec4 cy = vec4(center.y);
+		vec4 cz = vec4(center.z);
+		vec4 r2 = vec4(radius * radius);
+
+		for(uint32_t i = begin; i < end; i += 4)
+		{
+			vec4 dx, dy, dz;
+
+			#if QM_USE_SSE
+
+			dx.packed = _mm_sub_ps(_mm_loadu_ps(xs + i), cx.packed);
+			dy.packed = _mm_sub_ps(_mm_loadu_ps(ys + i), cy.packed);
+			dz.packed = _mm_sub_ps(_mm_loadu_ps(zs + i), cz.packed);
+
+			#else
+
+			dx = vec4(xs[i], xs[i + 1], xs[i + 2], xs[i + 3]) - cx;
+			dy = vec4(ys[i], ys[i + 1], ys[i + 2], ys[i + 3]) - cy;
+			dz = vec4(zs[i], zs[i + 1], zs[i + 2], zs[i + 3]) - cz;
+
+			#endif
+
+			int hit = mask_le(dx * dx + dy * dy + dz * dz, r2);
+			if(end - i < 4)
+				hit &= (1 << (end - i)) - 1;
+
+			while(hit)
+			{
+				int lane = 0;
+				while(!((hit >> lane) & 1))
+					lane++;
+				hit &= ~(1 << lane);
+
+				if(count < maxOut)
+					out[count] = indices[i + lane];
+
+				count++;
+			}
+		}
+
+		return count;
+	};
+};
+
+//----------------------------------------------------------------------//
+//PRIMITIVE FUNCTIONS:
+
+inline plane::plane(const vec3& _normal, const vec3& _point)
+{
+	normal = _normal;
+	d = -dot(_normal, _point);
+}
+
+//signed distance from the plane, positive on the side the normal faces (the normal must be normalized):
+inline float distance(const plane& p, const vec3& point)
+{
+	return dot(p.normal, point) + p.d;
+}
+
+//closest points:
+
+inline vec3 closest_point(const plane& p, const vec3& point)
+{
+	return point - p.normal * distance(p, point);
+}
+
+inline vec3 closest_point(const sphere& s, const vec3& point)
+{
+	vec3 d = point - s.center;
+	float len2 = dot(d, d);
+	if(len2 <= s.radius * s.radius)
+		return point;
+
+	return s.center + d * (s.radius / QM_SQRTF(len2));
+}
+
+inline vec3 closest_point(const aabb& b, const vec3& point)
+{
+	return min(max(point, b.min), b.max);
+}
+
+inline vec3 closest_point(const segment& s, const vec3& point)
+{
+	vec3 ab = s.b - s.a;
+	float len2 = dot(ab, ab);
+	if(len2 <= 0.0f)
+		return s.a;
+
+	float t = dot(point - s.a, ab) / len2;
+	t = QM_MAX(t, 0.0f);
+	t = QM_MIN(t, 1.0f);
+
+	return s.a + ab * t;
+}
+
+inline vec3 closest_point(const capsule& c, const vec3& point)
+{
+	return closest_point(sphere(closest_point(segment(c.a, c.b), point), c.radius), point);
+}
+
+//closest points between 2 segments, returns their squared distance
+inline float closest_points(const segment& s1, const segment& s2, vec3* c1, vec3* c2)
+{
+	vec3 d1 = s1.b - s1.a;
+	vec3 d2 = s2.b - s2.a;
+	vec3 r = s1.a - s2.a;
+
+	float a = dot(d1, d1);
+	float e = dot(d2, d2);
+	float f = dot(d2, r);
+
+	float s, t;
+	if(a <= 1e-12f && e <= 1e-12f)
+	{
+		s = 0.0f;
+		t = 0.0f;
+	}
+	else if(a <= 1e-12f)
+	{
+		s = 0.0f;
+		t = QM_MIN(QM_MAX(f / e, 0.0f), 1.0f);
+	}
+	else
+	{
+		float c = dot(d1, r);
+		if(e <= 1e-12f)
+		{
+			t = 0.0f;
+			s = QM_MIN(QM_MAX(-c / a, 0.0f), 1.0f);
+		}
+		else
+		{
+			float b = dot(d1, d2);
+			float denom = a * e - b * b;
+
+			s = denom != 0.0f ? QM_MIN(QM_MAX((b * f - c * e) / denom, 0.0f), 1.0f) : 0.0f;
+			t = (b * s + f) / e;
+
+			if(t < 0.0f)
+			{
+				t = 0.0f;
+				s = QM_MIN(QM_MAX(-c / a, 0.0f), 1.0f);
+			}
+			else if(t > 1.0f)
+			{
+				t = 1.0f;
+				s = QM_MIN(QM_MAX((b - c) / a, 0.0f), 1.0f);
+			}
+		}
+	}
+
+	*c1 = s1.a + d1 * s;
+	*c2 = s2.a + d2 * t;
+
+	vec3 d = *c1 - *c2;
+	return dot(d, d);
+}
+
+//overlap tests:
+
+inline bool overlap(const sphere& s1, const sphere& s2)
+{
+	vec3 d = s1.center - s2.center;
+	float r = s1.radius + s2.radius;
+	return dot(d, d) <= r * r;
+}
+
+inline bool overlap(const sphere& s, const aabb& b)
+{
+	return distance_squared(b, s.center) <= s.radius * s.radius;
+}
+
+inline bool overlap(const plane& p, const sphere& s)
+{
+	return QM_FABSF(distance(p, s.center)) <= s.radius;
+}
+
+inline bool overlap(const sphere& s, const capsule& c)
+{
+	vec3 d = closest_point(segment(c.a, c.b), s.center) - s.center;
+	float r = s.radius + c.radius;
+	return dot(d, d) <= r * r;
+}
+
+inline bool overlap(const capsule& c1, const capsule& c2)
+{
+	vec3 p1, p2;
+	float r = c1.radius + c2.radius;
+	return closest_points(segment(c1.a, c1.b), segment(c2.a, c2.b), &p1, &p2) <= r * r;
+}
+
+//batch overlap tests, testing one shape against n others stored as SoA
+//the indices of the overlapping ones are written to out (which must hold n), the number found is returned:
+
+inline size_t overlap(const sphere& s, const sphere_array& spheres, size_t n, uint32_t* out)
+{
+	size_t result = 0;
+	size_t i = 0;
+
+	vec4 cx = vec4(s.center.x);
+	vec4 cy = vec4(s.center.y);
+	vec4 cz = vec4(s.center.z);
+	vec4 cr = vec4(s.radius);
+
+	for(; i + 4 <= n; i += 4)
+	{
+		vec4 dx = load4(spheres.x + i) - cx;
+		vec4 dy = load4(spheres.y + i) - cy;
+		vec4 dz = load4(spheres.z + i) - cz;
+		vec4 r  = load4(spheres.radius + i) + cr;
+
+		result = append_lanes(mask_le(dx * dx + dy * dy + dz * dz, r * r), i, out, result);
+	}
+
+	for(; i < n; i++)
+		if(overlap(s, sphere(vec3(spheres.x[i], spheres.y[i], spheres.z[i]), spheres.radius[i])))
+			out[result++] = (uint32_t)i;
+
+	return result;
+}
+
+inline size_t overlap(const sphere& s, const aabb_array& boxes, size_t n, uint32_t* out)
+{
+	size_t result = 0;
+	size_t i = 0;
+
+	vec3x4 c = vec3x4(s.center);
+	vec4 r2 = vec4(s.radius * s.radius);
+	vec3x4 zero = vec3x4(vec3(0.0f));
+
+	for(; i + 4 <= n; i += 4)
+	{
+		vec3x4 bMin = vec3x4(load4(boxes.minX + i), load4(boxes.minY + i), load4(boxes.minZ + i));
+		vec3x4 bMax = vec3x4(load4(boxes.maxX + i), load4(boxes.maxY + i), load4(boxes.maxZ + i));
+
+		vec3x4 d = max(max(bMin - c, c - bMax), zero);
+		result = append_lanes(mask_le(dot(d, d), r2), i, out, result);
+	}
+
+	for(; i < n; i++)
+	{
+		aabb b = aabb(vec3(boxes.minX[i], boxes.minY[i], boxes.minZ[i]), vec3(boxes.maxX[i], boxes.maxY[i], boxes.maxZ[i]));
+		if(overlap(s, b))
+			out[result++] = (uint32_t)i;
+	}
+
+	return result;
+}
+
+inline size_t overlap(const aabb& b, const sphere_array& spheres, size_t n, uint32_t* out)
+{
+	size_t result = 0;
+	size_t i = 0;
+
+	vec3x4 bMin = vec3x4(b.min);
+	vec3x4 bMax = vec3x4(b.max);
+	vec3x4 zero = vec3x4(vec3(0.0f));
+
+	for(; i + 4 <= n; i += 4)
+	{
+		vec3x4 c = vec3x4(load4(spheres.x + i), load4(spheres.y + i), load4(spheres.z + i));
+		vec4 r = load4(spheres.radius + i);
+
+		vec3x4 d = max(max(bMin - c, c - bMax), zero);
+		result = append_lanes(mask_le(dot(d, d), r * r), i, out, result);
+	}
+
+	for(; i < n; i++)
+		if(overlap(sphere(vec3(spheres.x[i], spheres.y[i], spheres.z[i]), spheres.radius[i]), b))
+			out[result++] = (uint32_t)i;
+
+	return result;
+}
+
+inline size_t overlap(const aabb& b, const aabb_array& boxes, size_t n, uint32_t* out)
+{
+	size_t result = 0;
+	size_t i = 0;
+
+	vec3x4 bMin = vec3x4(b.min);
+	vec3x4 bMax = vec3x4(b.max);
+
+	for(; i + 4 <= n; i += 4)
+	{
+		int hit = mask_le(load4(boxes.minX + i), bMax.x) & mask_le(bMin.x, load4(boxes.maxX + i)) &
+		          mask_le(load4(boxes.minY + i), bMax.y) & mask_le(bMin.y, load4(boxes.maxY + i)) &
+		          mask_le(load4(boxes.minZ + i), bMax.z) & mask_le(bMin.z, load4(boxes.maxZ + i));
+
+		result = append_lanes(hit, i, out, result);
+	}
+
+	for(; i < n; i++)
+	{
+		aabb other = aabb(vec3(boxes.minX[i], boxes.minY[i], boxes.minZ[i]), vec3(boxes.maxX[i], boxes.maxY[i], boxes.maxZ[i]));
+		if(overlap(b, other))
+			out[result++] = (uint32_t)i;
+	}
+
+	return result;
+}
+
+inline size_t overlap(const plane& p, const sphere_array& spheres, size_t n, uint32_t* out)
+{
+	size_t result = 0;
+	size_t i = 0;
+
+	vec3x4 normal = vec3x4(p.normal);
+	vec4 d = vec4(p.d);
+
+	for(; i + 4 <= n; i += 4)
+	{
+		vec3x4 c = vec3x4(load4(spheres.x + i), load4(spheres.y + i), load4(spheres.z + i));
+		vec4 r = load4(spheres.radius + i);
+
+		vec4 dist = dot(normal, c) + d;
+		result = append_lanes(mask_le(dist, r) & mask_le(vec4(0.0f) - r, dist), i, out, result);
+	}
+
+	for(; i < n; i++)
+		if(overlap(p, sphere(vec3(spheres.x[i], spheres.y[i], spheres.z[i]), spheres.radius[i])))
+			out[result++] = (uint32_t)i;
+
+	return result;
+}
+
+//batch point queries over n points stored as SoA:
+
+inline void distance(const plane& p, const vec3_array& points, size_t n, float* out)
+{
+	size_t i = 0;
+
+	vec3x4 normal = vec3x4(p.normal);
+	vec4 d = vec4(p.d);
+
+	for(; i + 4 <= n; i += 4)
+	{
+		vec3x4 point = vec3x4(load4(points.x + i), load4(points.y + i), load4(points.z + i));
+		store4(out + i, dot(normal, point) + d);
+	}
+
+	for(; i < n; i++)
+		out[i] = distance(p, vec3(points.x[i], points.y[i], points.z[i]));
+}
+
+inline void closest_point(const plane& p, const vec3_array& points, size_t n, const vec3_out_array& out)
+{
+	size_t i = 0;
+
+	vec3x4 normal = vec3x4(p.normal);
+	vec4 d = vec4(p.d);
+
+	for(; i + 4 <= n; i += 4)
+	{
+		vec3x4 point = vec3x4(load4(points.x + i), load4(points.y + i), load4(points.z + i));
+		vec3x4 result = point - normal * (dot(normal, point) + d);
+
+		store4(out.x + i, result.x);
+		store4(out.y + i, result.y);
+		store4(out.z + i, result.z);
+	}
+
+	for(; i < n; i++)
+	{
+		vec3 result = closest_point(p, vec3(points.x[i], points.y[i], points.z[i]));
+		out.x[i] = result.x;
+		out.y[i] = result.y;
+		out.z[i] = result.z;
+	}
+}
+
+inline void closest_point(const sphere& s, const vec3_array& points, size_t n, const vec3_out_array& out)
+{
+	size_t i = 0;
+
+	vec3x4 c = vec3x4(s.center);
+	vec4 r = vec4(s.radius);
+
+	for(; i + 4 <= n; i += 4)
+	{
+		vec3x4 point = vec3x4(load4(points.x + i), load4(points.y + i), load4(points.z + i));
+		vec3x4 d = point - c;
+		vec4 len = dot(d, d);
+
+		#if QM_USE_SSE
+
+		len.packed = _mm_sqrt_ps(len.packed);
+
+		#else
+
+		for(int j = 0; j < 4; j++)
+			len.v[j] = QM_SQRTF(len.v[j]);
+
+		#endif
+
+		//points inside the sphere are their own closest point:
+		int inside = mask_le(len, r);
+		vec4 scale = select(inside, vec4(1.0f), r / select(inside, vec4(1.0f), len));
+		vec3x4 result = c + d * scale;
+
+		store4(out.x + i, result.x);
+		store4(out.y + i, result.y);
+		store4(out.z + i, result.z);
+	}
+
+	for(; i < n; i++)
+	{
+		vec3 result = closest_point(s, vec3(points.x[i], points.y[i], points.z[i]));
+		out.x[i] = result.x;
+		out.y[i] = result.y;
+		out.z[i] = result.z;
+	}
+}
+
+inline void closest_point(const aabb& b, const vec3_array& points, size_t n, const vec3_out_array& out)
+{
+	size_t i = 0;
+
+	vec3x4 bMin = vec3x4(b.min);
+	vec3x4 bMax = vec3x4(b.max);
+
+	for(; i + 4 <= n; i += 4)
+	{
+		vec3x4 point = vec3x4(load4(points.x + i), load4(points.y + i), load4(points.z + i));
+		vec3x4 result = min(max(point, bMin), bMax);
+
+		store4(out.x + i, result.x);
+		store4(out.y + i, result.y);
+		store4(out.z + i, result.z);
+	}
+
+	for(; i < n; i++)
+	{
+		vec3 result = closest_point(b, vec3(points.x[i], points.y[i], points.z[i]));
+		out.x[i] = result.x;
+		out.y[i] = result.y;
+		out.z[i] = result.z;
+	}
+}
+
+inline void closest_point(const segment& s, const vec3_array& points, size_t n, const vec3_out_array& out)
+{
+	size_t i = 0;
+
+	vec3 ab = s.b - s.a;
+	float len2 = dot(ab, ab);
+	float invLen2 = len2 > 0.0f ? 1.0f / len2 : 0.0f;
+
+	vec3x4 a = vec3x4(s.a);
+	vec3x4 dir = vec3x4(ab);
+
+	for(; i + 4 <= n; i += 4)
+	{
+		vec3x4 point = vec3x4(load4(points.x + i), load4(points.y + i), load4(points.z + i));
+		vec4 t = dot(point - a, dir) * invLen2;
+		t = min(max(t, vec4(0.0f)), vec4(1.0f));
+
+		vec3x4 result = a + dir * t;
+
+		store4(out.x + i, result.x);
+		store4(out.y + i, result.y);
+		store4(out.z + i, result.z);
+	}
+
+	for(; i < n; i++)
+	{
+		vec3 result = closest_point(s, vec3(points.x[i], points.y[i], points.z[i]));
+		out.x[i] = result.x;
+		out.y[i] = result.y;
+		out.z[i] = result.z;
+	}
+}
+
+//oriented boxes:
+
+inline obb::obb(const vec3& _center, const quaternion& _rotation, const vec3& _halfExtents)
+{
+	mat4 rot = quaternion_to_mat4(_rotation);
+
+	center = _center;
+	for(int i = 0; i < 3; i++)
+		axes.v[i] = vec3(rot.m[i][0], rot.m[i][1], rot.m[i][2]);
+	halfExtents = _halfExtents;
+}
+
+inline vec3 closest_point(const obb& b, const vec3& point)
+{
+	vec3 d = point - b.center;
+	vec3 result = b.center;
+
+	for(int i = 0; i < 3; i++)
+	{
+		float dist = dot(d, b.axes.v[i]);
+		dist = QM_MAX(dist, -b.halfExtents.v[i]);
+		dist = QM_MIN(dist,  b.halfExtents.v[i]);
+
+		result = result + b.axes.v[i] * dist;
+	}
+
+	return result;
+}
+
+//separating axis test over the 15 candidate axes (3 of a, 3 of b, 9 edge cross products), 3 axes at a time
+inline bool overlap(const obb& a, const obb& b)
+{
+	//rotation of b in a's frame, r[i] holds the dot products of a's axis i with each of b's axes
+	//the epsilon keeps near-parallel edges from producing degenerate cross products:
+	vec3x4 bAxes = vec3x4(b.axes.v[0], b.axes.v[1], b.axes.v[2], vec3(0.0f));
+	vec4 r[3];
+	vec4 absR[3];
+	for(int i = 0; i < 3; i++)
+	{
+		r[i] = dot(vec3x4(a.axes.v[i]), bAxes);
+		absR[i] = abs(r[i]) + vec4(1e-6f);
+	}
+
+	vec3 d = b.center - a.center;
+	vec4 t  = vec4(dot(d, a.axes.v[0]), dot(d, a.axes.v[1]), dot(d, a.axes.v[2]), 0.0f);
+	vec4 ea = vec4(a.halfExtents, 0.0f);
+	vec4 eb = vec4(b.halfExtents, 0.0f);
+
+	int separated;
+
+	//axes of a:
+	vec4 rb = vec4(dot(absR[0], eb), dot(absR[1], eb), dot(absR[2], eb), 0.0f);
+	separated = mask_lt(ea + rb, abs(t));
+
+	//axes of b:
+	vec4 ra = absR[0] * ea.x + absR[1] * ea.y + absR[2] * ea.z;
+	separated |= mask_lt(ra + eb, abs(r[0] * t.x + r[1] * t.y + r[2] * t.z));
+
+	//a's axis i crossed with each of b's axes:
+	vec4 ebYZX = vec4(eb.y, eb.z, eb.x, 0.0f);
+	vec4 ebZXY = vec4(eb.z, eb.x, eb.y, 0.0f);
+	for(int i = 0; i < 3; i++)
+	{
+		int i1 = (i + 1) % 3;
+		int i2 = (i + 2) % 3;
+
+		vec4 absRYZX = vec4(absR[i].y, absR[i].z, absR[i].x, 0.0f);
+		vec4 absRZXY = vec4(absR[i].z, absR[i].x, absR[i].y, 0.0f);
+
+		ra = absR[i2] * ea.v[i1] + absR[i1] * ea.v[i2];
+		rb = ebYZX * absRZXY + ebZXY * absRYZX;
+		separated |= mask_lt(ra + rb, abs(r[i1] * t.v[i2] - r[i2] * t.v[i1]));
+	}
+
+	return separated == 0;
+}
+
+//tests a against n boxes, 4 at a time, writing the indices of the overlapping ones to out (which must hold n)
+//returns the number found
+inline size_t overlap(const obb& a, const obb* boxes, size_t n, uint32_t* out)
+{
+	size_t result = 0;
+	size_t i = 0;
+
+	vec3x4 aAxes[3];
+	for(int k = 0; k < 3; k++)
+		aAxes[k] = vec3x4(a.axes.v[k]);
+
+	vec3x4 aCenter = vec3x4(a.center);
+	const vec3& ea = a.halfExtents;
+
+	for(; i + 4 <= n; i += 4)
+	{
+		const obb* b = boxes + i;
+
+		//r[k][j] is the dot product of a's axis k with axis j of each b:
+		vec4 r[3][3];
+		vec4 absR[3][3];
+		for(int j = 0; j < 3; j++)
+		{
+			vec3x4 bAxis = vec3x4(b[0].axes.v[j], b[1].axes.v[j], b[2].axes.v[j], b[3].axes.v[j]);
+			for(int k = 0; k < 3; k++)
+			{
+				r[k][j] = dot(aAxes[k], bAxis);
+				absR[k][j] = abs(r[k][j]) + vec4(1e-6f);
+			}
+		}
+
+		vec3x4 d = vec3x4(b[0].center, b[1].center, b[2].center, b[3].center) - aCenter;
+		vec3x4 ebs = vec3x4(b[0].halfExtents, b[1].halfExtents, b[2].halfExtents, b[3].halfExtents);
+
+		vec4 t[3];
+		vec4 eb[3] = {ebs.x, ebs.y, ebs.z};
+		for(int k = 0; k < 3; k++)
+			t[k] = dot(d, aAxes[k]);
+
+		int separated = 0;
+
+		//axes of a:
+		for(int k = 0; k < 3; k++)
+		{
+			vec4 rb = absR[k][0] * eb[0] + absR[k][1] * eb[1] + absR[k][2] * eb[2];
+			separated |= mask_lt(rb + ea.v[k], abs(t[k]));
+		}
+
+		//axes of b:
+		for(int j = 0; j < 3; j++)
+		{
+			vec4 ra = absR[0][j] * ea.x + absR[1][j] * ea.y + absR[2][j] * ea.z;
+			separated |= mask_lt(ra + eb[j], abs(t[0] * r[0][j] + t[1] * r[1][j] + t[2] * r[2][j]));
+		}
+
+		//cross products:
+		for(int k = 0; k < 3; k++)
+		{
+			int k1 = (k + 1) % 3;
+			int k2 = (k + 2) % 3;
+
+			for(int j = 0; j < 3; j++)
+			{
+				int j1 = (j + 1) % 3;
+				int j2 = (j + 2) % 3;
+
+				vec4 ra = absR[k2][j] * ea.v[k1] + absR[k1][j] * ea.v[k2];
+				vec4 rb = absR[k][j2] * eb[j1] + absR[k][j1] * eb[j2];
+				separated |= mask_lt(ra + rb, abs(t[k2] * r[k1][j] - t[k1] * r[k2][j]));
+			}
+		}
+
+		result = append_lanes(~separated & 0xF, i, out, result);
+	}
+
+	for(; i < n; i++)
+		if(overlap(a, boxes[i]))
+			out[result++] = (uint32_t)i;
+
+	return result;
+}
+
+//----------------------------------------------------------------------//
+//GJK/EPA:
+
+//support functions, each returns the point of the shape furthest along dir:
+
+inline vec3 support(const vec3& point, const vec3& dir)
+{
+	(void)dir;
+	return point;
+}
+
+inline vec3 support(const sphere& s, const vec3& dir)
+{
+	float len2 = dot(dir, dir);
+	if(len2 <= 0.0f)
+		return s.center;
+
+	return s.center + dir * (s.radius / QM_SQRTF(len2));
+}
+
+inline vec3 support(const capsule& c, const vec3& dir)
+{
+	vec3 end = dot(c.a, dir) > dot(c.b, dir) ? c.a : c.b;
+	return support(sphere(end, c.radius), dir);
+}
+
+inline vec3 support(const aabb& b, const vec3& dir)
+{
+	return vec3(dir.x >= 0.0f ? b.max.x : b.min.x,
+	            dir.y >= 0.0f ? b.max.y : b.min.y,
+	            dir.z >= 0.0f ? b.max.z : b.min.z);
+}
+
+inline vec3 support(const obb& b, const vec3& dir)
+{
+	vec3 result = b.center;
+	for(int i = 0; i < 3; i++)
+	{
+		float side = dot(dir, b.axes.v[i]) >= 0.0f ? b.halfExtents.v[i] : -b.halfExtents.v[i];
+		result = result + b.axes.v[i] * side;
+	}
+
+	return result;
+}
+
+//searches the vertices 4 at a time, the hull must have at least 1 vertex
+inline vec3 support(const convex_hull& h, const vec3& dir)
+{
+	size_t i = 0;
+	size_t best = 0;
+	float bestDot = -INFINITY;
+
+	if(h.count >= 4)
+	{
+		vec3x4 d = vec3x4(dir);
+		vec4 laneDots = vec4(-INFINITY);
+		vec4 laneIndices = vec4(0.0f); //stored as floats, exact for up to 2^24 vertices
+		vec4 indices = vec4(0.0f, 1.0f, 2.0f, 3.0f);
+
+		for(; i + 4 <= h.count; i += 4)
+		{
+			const vec3* v = h.vertices + i;
+			vec4 dots = dot(vec3x4(v[0], v[1], v[2], v[3]), d);
+
+			int better = mask_lt(laneDots, dots);
+			laneDots    = select(better, dots, laneDots);
+			laneIndices = select(better, indices, laneIndices);
+			indices = indices + vec4(4.0f);
+		}
+
+		for(int lane = 0; lane < 4; lane++)
+			if(laneDots.v[lane] > bestDot)
+			{
+				bestDot = laneDots.v[lane];
+				best = (size_t)laneIndices.v[lane];
+			}
+	}
+
+	for(; i < h.count; i++)
+	{
+		float d = dot(h.vertices[i], dir);
+		if(d > bestDot)
+		{
+			bestDot = d;
+			best = i;
+		}
+	}
+
+	return h.vertices[best];
+}
+
+//-----------------------------//
+
+struct gjk_result
+{
+	bool  intersecting;
+	float distance; //separation distance, 0 when intersecting
+	float depth;    //penetration depth (only computed by epa()), 0 when separated
+	vec3  normal;   //unit vector from a towards b, moving b along it by depth separates the shapes
+	vec3  pointA;   //closest/deepest point on a
+	vec3  pointB;   //closest/deepest point on b
+};
+
+//a simplex of points on the minkowski difference a - b, keeping the support points they came from
+struct gjk_simplex
+{
+	vec3  a[4];
+	vec3  b[4];
+	vec3  w[4];
+	float bary[4];
+	int   count = 0;
+
+	void add(const vec3& _a, const vec3& _b)
+	{
+		a[count] = _a;
+		b[count] = _b;
+		w[count] = _a - _b;
+		count++;
+	};
+
+	//whether p is (almost) one of the vertices, points this close add nothing but float noise
+	bool contains(const vec3& p) const
+	{
+		float tolerance = 1e-8f * QM_MAX(scale(), dot(p, p));
+		for(int i = 0; i < count; i++)
+		{
+			vec3 d = w[i] - p;
+			if(dot(d, d) <= tolerance)
+				return true;
+		}
+
+		return false;
+	};
+
+	//barycentric coordinates of the closest point to the origin on the triangle (w0, w1, w2)
+	//the interior and each edge are tried in turn, which stays robust for the slivers GJK produces
+	static void closest_triangle(const vec3& w0, const vec3& w1, const vec3& w2, float* bary)
+	{
+		const vec3* w[3] = {&w0, &w1, &w2};
+		float best = INFINITY;
+
+		//interior, if the origin projects inside the triangle:
+		vec3 n = cross(w1 - w0, w2 - w0);
+		float nn = dot(n, n);
+		if(nn > 0.0f)
+		{
+			float b0 = dot(cross(w1, w2), n) / nn;
+			float b1 = dot(cross(w2, w0), n) / nn;
+			float b2 = 1.0f - b0 - b1;
+
+			if(b0 >= 0.0f && b1 >= 0.0f && b2 >= 0.0f)
+			{
+				vec3 p = w0 * b0 + w1 * b1 + w2 * b2;
+				best = dot(p, p);
+
+				bary[0] = b0;
+				bary[1] = b1;
+				bary[2] = b2;
+			}
+		}
+
+		//edges, including their endpoints:
+		for(int i = 0; i < 3; i++)
+		{
+			int j = (i + 1) % 3;
+			int k = (i + 2) % 3;
+
+			vec3 edge = *w[j] - *w[i];
+			float len2 = dot(edge, edge);
+			float t = len2 > 0.0f ? -dot(*w[i], edge) / len2 : 0.0f;
+			t = QM_MAX(t, 0.0f);
+			t = QM_MIN(t, 1.0f);
+
+			vec3 p = *w[i] + edge * t;
+			float dist = dot(p, p);
+			if(dist < best)
+			{
+				best = dist;
+				bary[i] = 1.0f - t;
+				bary[j] = t;
+				bary[k] = 0.0f;
+			}
+		}
+	};
+
+	//finds the closest point to the origin, drops the vertices not needed to express it
+	//returns false if the origin is inside the tetrahedron
+	bool solve(vec3* closest)
+	{
+		switch(count)
+		{
+		case 1:
+			bary[0] = 1.0f;
+			break;
+		case 2:
+		{
+			vec3 ab = w[1] - w[0];
+			float len2 = dot(ab, ab);
+			float t = len2 > 0.0f ? -dot(w[0], ab) / len2 : 0.0f;
+			t = QM_MAX(t, 0.0f);
+			t = QM_MIN(t, 1.0f);
+
+			bary[0] = 1.0f - t;
+			bary[1] = t;
+			break;
+		}
+		case 3:
+			closest_triangle(w[0], w[1], w[2], bary);
+			break;
+		case 4:
+		{
+			static const int faces[4][4] = {{0, 1, 2, 3}, {0, 1, 3, 2}, {0, 2, 3, 1}, {1, 2, 3, 0}};
+
+			//a tetrahedron this flat can't be trusted to contain the origin, float noise decides the sides:
+			vec3 e1 = w[1] - w[0];
+			vec3 e2 = w[2] - w[0];
+			vec3 e3 = w[3] - w[0];
+			float volume = dot(cross(e1, e2), e3);
+			float edge2 = QM_MAX(QM_MAX(dot(e1, e1), dot(e2, e2)), dot(e3, e3));
+
+			//inside if the origin is on the same side of every face as the opposite vertex:
+			bool inside = volume * volume > 1e-12f * edge2 * edge2 * edge2;
+			for(int f = 0; f < 4 && inside; f++)
+			{
+				const int* idx = faces[f];
+				vec3 n = cross(w[idx[1]] - w[idx[0]], w[idx[2]] - w[idx[0]]);
+				inside = -dot(w[idx[0]], n) * dot(w[idx[3]] - w[idx[0]], n) > 0.0f;
+			}
+
+			if(inside)
+			{
+				*closest = vec3(0.0f);
+				return false;
+			}
+
+			//otherwise the closest point is on the closest face:
+			float bestDist = INFINITY;
+			float best[4] = {};
+			for(int f = 0; f < 4; f++)
+			{
+				const int* idx = faces[f];
+
+				float faceBary[3];
+				closest_triangle(w[idx[0]], w[idx[1]], w[idx[2]], faceBary);
+
+				vec3 p = w[idx[0]] * faceBary[0] + w[idx[1]] * faceBary[1] + w[idx[2]] * faceBary[2];
+				float dist = dot(p, p);
+				if(dist < bestDist)
+				{
+					bestDist = dist;
+					best[0] = best[1] = best[2] = best[3] = 0.0f;
+					for(int i = 0; i < 3; i++)
+						best[idx[i]] = faceBary[i];
+				}
+			}
+
+			for(int i = 0; i < 4; i++)
+				bary[i] = best[i];
+
+			break;
+		}
+		}
+
+		//compact:
+		int kept = 0;
+		*closest = vec3(0.0f);
+		for(int i = 0; i < count; i++)
+		{
+			if(bary[i] <= 0.0f)
+				continue;
+
+			a[kept] = a[i];
+			b[kept] = b[i];
+			w[kept] = w[i];
+			bary[kept] = bary[i];
+			*closest = *closest + w[i] * bary[i];
+			kept++;
+		}
+
+		count = kept;
+		return true;
+	};
+
+	//squared length of the furthest vertex, used to scale tolerances:
+	float scale() const
+	{
+		float result = 0.0f;
+		for(int i = 0; i < count; i++)
+			result = QM_MAX(result, dot(w[i], w[i]));
+
+		return result;
+	};
+
+	void witness_points(vec3* pointA, vec3* pointB) const
+	{
+		*pointA = vec3(0.0f);
+		*pointB = vec3(0.0f);
+		for(int i = 0; i < count; i++)
+		{
+			*pointA = *pointA + a[i] * bary[i];
+			*pointB = *pointB + b[i] * bary[i];
+		}
+	};
+};
+
+//runs GJK, leaving the final simplex in s, returns whether the shapes intersect
+template<typename A, typename B>
+bool gjk_solve(const A& a, const B& b, gjk_simplex* s, vec3* closest)
+{
+	const int MAX_ITERATIONS = 64;
+
+	s->count = 0;
+	vec3 dir = vec3(1.0f, 0.0f, 0.0f);
+	s->add(support(a, dir), support(b, -1.0f * dir));
+	s->bary[0] = 1.0f;
+
+	vec3 v = s->w[0];
+	float maxScale = s->scale();
+	for(int i = 0; i < MAX_ITERATIONS; i++)
+	{
+		//the origin is on the simplex, up to float precision:
+		float vv = dot(v, v);
+		if(vv <= 1e-8f * maxScale)
+		{
+			*closest = vec3(0.0f);
+			return true;
+		}
+
+		vec3 sa = support(a, -1.0f * v);
+		vec3 sb = support(b, v);
+		vec3 w = sa - sb;
+
+		//no further progress towards the origin:
+		if(vv - dot(v, w) <= 1e-5f * vv + 1e-6f * maxScale || s->contains(w))
+			break;
+
+		s->add(sa, sb);
+		maxScale = QM_MAX(maxScale, dot(w, w));
+
+		if(!s->solve(&v))
+		{
+			*closest = vec3(0.0f);
+			return true;
+		}
+	}
+
+	*closest = v;
+	return false;
+}
+
+//fills result from the final simplex and closest point of gjk_solve():
+inline void gjk_fill_result(const gjk_simplex& s, const vec3& closest, bool intersecting, gjk_result* result)
+{
+	result->intersecting = intersecting;
+	result->depth = 0.0f;
+	s.witness_points(&result->pointA, &result->pointB);
+
+	result->distance = intersecting ? 0.0f : QM_SQRTF(dot(closest, closest));
+	result->normal = result->distance > 0.0f ? (result->pointB - result->pointA) / result->distance : vec3(0.0f);
+}
+
+//computes whether 2 convex shapes intersect, and if not their distance and closest points
+//any types with a support() overload can be used (points, spheres, capsules, aabbs, obbs and convex hulls)
+template<typename A, typename B>
+bool gjk(const A& a, const B& b, gjk_result* result = nullptr)
+{
+	gjk_simplex s;
+	vec3 v;
+	bool intersecting = gjk_solve(a, b, &s, &v);
+
+	if(result)
+		gjk_fill_result(s, v, intersecting, result);
+
+	return intersecting;
+}
+
+//the polytope expanded by epa(), a convex hull of points on the minkowski difference a - b
+struct epa_polytope
+{
+	static const int MAX_VERTICES = 132;
+	static const int MAX_FACES    = 512;
+
+	struct face
+	{
+		int   idx[3];
+		vec3  normal;
+		float dist; //distance from the origin
+	};
+
+	vec3 a[MAX_VERTICES];
+	vec3 b[MAX_VERTICES];
+	vec3 w[MAX_VERTICES];
+	int  numVertices = 0;
+
+	face faces[MAX_FACES];
+	int  numFaces = 0;
+
+	int add_vertex(const vec3& _a, const vec3& _b)
+	{
+		a[numVertices] = _a;
+		b[numVertices] = _b;
+		w[numVertices] = _a - _b;
+		return numVertices++;
+	};
+
+	//returns false if the polytope is full or the face is degenerate (its edges are nearly parallel)
+	bool add_face(int i0, int i1, int i2)
+	{
+		vec3 e1 = w[i1] - w[i0];
+		vec3 e2 = w[i2] - w[i0];
+		vec3 n = cross(e1, e2);
+		float len2 = dot(n, n);
+		if(len2 <= 1e-12f * dot(e1, e1) * dot(e2, e2) || numFaces == MAX_FACES)
+			return false;
+
+		face& f = faces[numFaces++];
+		f.idx[0] = i0;
+		f.idx[1] = i1;
+		f.idx[2] = i2;
+		f.normal = n / QM_SQRTF(len2);
+		f.dist = dot(f.normal, w[i0]);
+		return true;
+	};
+
+	int closest_face() const
+	{
+		int result = 0;
+		for(int i = 1; i < numFaces; i++)
+			if(faces[i].dist < faces[result].dist)
+				result = i;
+
+		return result;
+	};
+
+	//removes the faces the new vertex sees and connects it to their boundary
+	//returns false if the boundary could not be closed, leaving a hole in the polytope
+	bool expand(int vertex)
+	{
+		int edges[MAX_FACES][2];
+		int numEdges = 0;
+
+		for(int i = 0; i < numFaces;)
+		{
+			//faces the vertex (nearly) lies on are removed too, so it is not connected to a collinear boundary edge:
+			vec3 d = w[vertex] - w[faces[i].idx[0]];
+			float side = dot(faces[i].normal, d);
+			if(side < 0.0f && side * side > 1e-12f * dot(d, d))
+			{
+				i++;
+				continue;
+			}
+
+			for(int e = 0; e < 3; e++)
+			{
+				int e0 = faces[i].idx[e];
+				int e1 = faces[i].idx[(e + 1) % 3];
+
+				//an edge shared with another removed face is not on the boundary:
+				bool shared = false;
+				for(int k = 0; k < numEdges && !shared; k++)
+					if(edges[k][0] == e1 && edges[k][1] == e0)
+					{
+						edges[k][0] = edges[numEdges - 1][0];
+						edges[k][1] = edges[numEdges - 1][1];
+						numEdges--;
+						shared = true;
+					}
+
+				if(!shared)
+				{
+					if(numEdges == MAX_FACES)
+						return false;
+
+					edges[numEdges][0] = e0;
+					edges[numEdges][1] = e1;
+					numEdges++;
+				}
+			}
+
+			faces[i] = faces[--numFaces];
+		}
+
+		for(int i = 0; i < numEdges; i++)
+			if(!add_face(edges[i][0], edges[i][1], vertex))
+				return false;
+
+		return numFaces > 0;
+	};
+};
+
+//runs gjk(), and if the shapes intersect finds the penetration depth and normal by expanding a polytope (EPA)
+template<typename A, typename B>
+bool epa(const A& a, const B& b, gjk_result* result)
+{
+	const int MAX_ITERATIONS = epa_polytope::MAX_VERTICES - 4;
+
+	gjk_simplex s;
+	vec3 v;
+	if(!gjk_solve(a, b, &s, &v))
+	{
+		gjk_fill_result(s, v, false, result);
+		return false;
+	}
+
+	result->intersecting = true;
+	result->distance = 0.0f;
+	result->depth = 0.0f;
+	result->normal = vec3(0.0f);
+	s.witness_points(&result->pointA, &result->pointB);
+
+	//grow the simplex to a tetrahedron around the origin:
+	static const vec3 axes[6] = {vec3(1.0f,  0.0f, 0.0f), vec3(-1.0f, 0.0f,  0.0f), vec3(0.0f, 1.0f, 0.0f),
+	                             vec3(0.0f, -1.0f, 0.0f), vec3( 0.0f, 0.0f,  1.0f), vec3(0.0f, 0.0f, -1.0f)};
+
+	while(s.count < 4)
+	{
+		vec3 dirs[6];
+		int numDirs = 0;
+
+		if(s.count == 1)
+		{
+			for(int i = 0; i < 6; i++)
+				dirs[numDirs++] = axes[i];
+		}
+		else if(s.count == 2)
+		{
+			vec3 d = s.w[1] - s.w[0];
+			vec3 axis = QM_FABSF(d.x) < QM_FABSF(d.y) ? (QM_FABSF(d.x) < QM_FABSF(d.z) ? axes[0] : axes[4]) :
+			                                            (QM_FABSF(d.y) < QM_FABSF(d.z) ? axes[2] : axes[4]);
+			vec3 perp1 = cross(d, axis);
+			vec3 perp2 = cross(d, perp1);
+
+			dirs[numDirs++] = perp1;
+			dirs[numDirs++] = perp2;
+			dirs[numDirs++] = -1.0f * perp1;
+			dirs[numDirs++] = -1.0f * perp2;
+		}
+		else
+		{
+			vec3 n = cross(s.w[1] - s.w[0], s.w[2] - s.w[0]);
+			dirs[numDirs++] = n;
+			dirs[numDirs++] = -1.0f * n;
+		}
+
+		bool added = false;
+		for(int i = 0; i < numDirs && !added; i++)
+		{
+			vec3 sa = support(a, dirs[i]);
+			vec3 sb = support(b, -1.0f * dirs[i]);
+			if(s.contains(sa - sb))
+				continue;
+
+			//the new point must not be coplanar with the triangle:
+			if(s.count == 3)
+			{
+				vec3 n = cross(s.w[1] - s.w[0], s.w[2] - s.w[0]);
+				if(QM_FABSF(dot(n, (sa - sb) - s.w[0])) <= 1e-10f)
+					continue;
+			}
+
+			s.add(sa, sb);
+			added = true;
+		}
+
+		//the shapes only touch:
+		if(!added)
+			return true;
+	}
+
+	epa_polytope poly;
+	for(int i = 0; i < 4; i++)
+		poly.add_vertex(s.a[i], s.b[i]);
+
+	//wind the tetrahedron faces outward:
+	static const int tetFaces[4][4] = {{0, 1, 2, 3}, {0, 1, 3, 2}, {0, 2, 3, 1}, {1, 2, 3, 0}};
+	for(int i = 0; i < 4; i++)
+	{
+		const int* idx = tetFaces[i];
+		vec3 n = cross(poly.w[idx[1]] - poly.w[idx[0]], poly.w[idx[2]] - poly.w[idx[0]]);
+		bool flip = dot(n, poly.w[idx[3]] - poly.w[idx[0]]) > 0.0f;
+
+		if(!(flip ? poly.add_face(idx[0], idx[2], idx[1]) : poly.add_face(idx[0], idx[1], idx[2])))
+			return true;
+	}
+
+	//the closest face is copied since expand() reorders the faces, its vertices stay valid:
+	epa_polytope::face f = poly.faces[poly.closest_face()];
+	for(int i = 0; i < MAX_ITERATIONS; i++)
+	{
+		vec3 sa = support(a, f.normal);
+		vec3 sb = support(b, -1.0f * f.normal);
+
+		if(dot(sa - sb, f.normal) - f.dist <= 1e-4f * QM_MAX(f.dist, 1.0f))
+			break;
+
+		//the polytope could not be expanded without a hole, keep the best face found so far:
+		if(!poly.expand(poly.add_vertex(sa, sb)))
+			break;
+
+		f = poly.faces[poly.closest_face()];
+	}
+
+	//the contact is the origin projected onto the closest face:
+	float bary[3];
+	gjk_simplex::closest_triangle(poly.w[f.idx[0]], poly.w[f.idx[1]], poly.w[f.idx[2]], bary);
+
+	result->depth = f.dist;
+	result->normal = f.normal;
+	result->pointA = poly.a[f.idx[0]] * bary[0] + poly.a[f.idx[1]] * bary[1] + poly.a[f.idx[2]] * bary[2];
+	result->pointB = poly.b[f.idx[0]] * bary[0] + poly.b[f.idx[1]] * bary[1] + poly.b[f.idx[2]] * bary[2];
+
+	return true;
+}
+
+//----------------------------------------------------------------------//
+//SPATIAL SORTING:
+
+//spreads the low 10 bits of x so there are 2 zero bits between each:
+inline uint32_t morton_spread(uint32_t x)
+{
+	x &= 0x000003FF;
+	x = (x | (x << 16)) & 0x030000FF;
+	x = (x | (x <<  8)) & 0x0300F00F;
+	x = (x | (x <<  4)) & 0x030C30C3;
+	x = (x | (x <<  2)) & 0x09249249;
+	return x;
+}
+
+//spreads the low 21 bits of x so there are 2 zero bits between each:
+inline uint64_t morton_spread(uint64_t x)
+{
+	x &= 0x00000000001FFFFFull;
+	x = (x | (x << 32)) & 0x001F00000000FFFFull;
+	x = (x | (x << 16)) & 0x001F0000FF0000FFull;
+	x = (x | (x <<  8)) & 0x100F00F00F00F00Full;
+	x = (x | (x <<  4)) & 0x10C30C30C30C30C3ull;
+	x = (x | (x <<  2)) & 0x1249249249249249ull;
+	return x;
+}
+
+//scale that maps bounds to grid coordinates in [0, maxCoord]:
+inline vec3 morton_scale(const aabb& bounds, float maxCoord)
+{
+	vec3 extent = bounds.max - bounds.min;
+	return vec3(extent.x > 0.0f ? maxCoord / extent.x : 0.0f,
+	            extent.y > 0.0f ? maxCoord / extent.y : 0.0f,
+	            extent.z > 0.0f ? maxCoord / extent.z : 0.0f);
+}
+
+#if QM_USE_SSE
+
+//quantizes 4 points to grid coordinates, one __m128i per axis:
+inline void morton_quantize(const vec3* points, const vec3x4& offset, const vec3x4& scale, float maxCoord, __m128i* coords)
+{
+	vec3x4 p = (vec3x4(points[0], points[1], points[2], points[3]) - offset) * scale;
+	p = min(max(p, vec3x4(vec3(0.0f))), vec3x4(vec3(maxCoord)));
+
+	coords[0] = _mm_cvttps_epi32(p.x.packed);
+	coords[1] = _mm_cvttps_epi32(p.y.packed);
+	coords[2] = _mm_cvttps_epi32(p.z.packed);
+}
+
+inline __m128i morton_spread(__m128i x)
+{
+	x = _mm_and_si128(_mm_or_si128(x, _mm_slli_epi32(x, 16)), _mm_set1_epi32(0x030000FF));
+	x = _mm_and_si128(_mm_or_si128(x, _mm_slli_epi32(x,  8)), _mm_set1_epi32(0x0300F00F));
+	x = _mm_and_si128(_mm_or_si128(x, _mm_slli_epi32(x,  4)), _mm_set1_epi32(0x030C30C3));
+	x = _mm_and_si128(_mm_or_si128(x, _mm_slli_epi32(x,  2)), _mm_set1_epi32(0x09249249));
+	return x;
+}
+
+//spreads each of the 2 64-bit lanes:
+inline __m128i morton_spread64(__m128i x)
+{
+	x = _mm_and_si128(_mm_or_si128(x, _mm_slli_epi64(x, 32)), _mm_set1_epi64x(0x001F00000000FFFFll));
+	x = _mm_and_si128(_mm_or_si128(x, _mm_slli_epi64(x, 16)), _mm_set1_epi64x(0x001F0000FF0000FFll));
+	x = _mm_and_si128(_mm_or_si128(x, _mm_slli_epi64(x,  8)), _mm_set1_epi64x(0x100F00F00F00F00Fll));
+	x = _mm_and_si128(_mm_or_si128(x, _mm_slli_epi64(x,  4)), _mm_set1_epi64x(0x10C30C30C30C30C3ll));
+	x = _mm_and_si128(_mm_or_si128(x, _mm_slli_epi64(x,  2)), _mm_set1_epi64x(0x1249249249249249ll));
+	return x;
+}
+
+#endif
+
+//computes 30-bit morton codes (10 bits per axis) of points quantized within bounds
+inline void morton_encode(const vec3* points, const aabb& bounds, uint32_t* out, size_t n)
+{
+	const float maxCoord = 1023.0f;
+	vec3 scale = morton_scale(bounds, maxCoord);
+
+	size_t i = 0;
+
+	#if QM_USE_SSE
+
+	vec3x4 offset4 = vec3x4(bounds.min);
+	vec3x4 scale4 = vec3x4(scale);
+
+	for(; i + 4 <= n; i += 4)
+	{
+		__m128i coords[3];
+		morton_quantize(points + i, offset4, scale4, maxCoord, coords);
+
+		__m128i code = morton_spread(coords[0]);
+		code = _mm_or_si128(code, _mm_slli_epi32(morton_spread(coords[1]), 1));
+		code = _mm_or_si128(code, _mm_slli_epi32(morton_spread(coords[2]), 2));
+
+		_mm_storeu_si128((__m128i*)(out + i), code);
+	}
+
+	#endif
+
+	for(; i < n; i++)
+	{
+		vec3 p = min(max((points[i] - bounds.min) * scale, vec3(0.0f)), vec3(maxCoord));
+		out[i] = morton_spread((uint32_t)p.x) | (morton_spread((uint32_t)p.y) << 1) | (morton_spread((uint32_t)p.z) << 2);
+	}
+}
+
+//computes 63-bit morton codes (21 bits per axis) of points quantized within bounds
+inline void morton_encode(const vec3* points, const aabb& bounds, uint64_t* out, size_t n)
+{
+	const float maxCoord = 2097151.0f;
+	vec3 scale = morton_scale(bounds, maxCoord);
+
+	size_t i = 0;
+
+	#if QM_USE_SSE
+
+	vec3x4 offset4 = vec3x4(bounds.min);
+	vec3x4 scale4 = vec3x4(scale);
+	__m128i zero = _mm_setzero_si128();
+
+	for(; i + 4 <= n; i += 4)
+	{
+		__m128i coords[3];
+		morton_quantize(points + i, offset4, scale4, maxCoord, coords);
+
+		//widen to 64-bit lanes, points 0 and 1 in lo, 2 and 3 in hi:
+		__m128i lo = morton_spread64(_mm_unpacklo_epi32(coords[0], zero));
+		__m128i hi = morton_spread64(_mm_unpackhi_epi32(coords[0], zero));
+		lo = _mm_or_si128(lo, _mm_slli_epi64(morton_spread64(_mm_unpacklo_epi32(coords[1], zero)), 1));
+		hi = _mm_or_si128(hi, _mm_slli_epi64(morton_spread64(_mm_unpackhi_epi32(coords[1], zero)), 1));
+		lo = _mm_or_si128(lo, _mm_slli_epi64(morton_spread64(_mm_unpacklo_epi32(coords[2], zero)), 2));
+		hi = _mm_or_si128(hi, _mm_slli_epi64(morton_spread64(_mm_unpackhi_epi32(coords[2], zero)), 2));
+
+		_mm_storeu_si128((__m128i*)(out + i    ), lo);
+		_mm_storeu_si128((__m128i*)(out + i + 2), hi);
+	}
+
+	#endif
+
+	for(; i < n; i++)
+	{
+		vec3 p = min(max((points[i] - bounds.min) * scale, vec3(0.0f)), vec3(maxCoord));
+		out[i] = morton_spread((uint64_t)p.x) | (morton_spread((uint64_t)p.y) << 1) | (morton_spread((uint64_t)p.z) << 2);
+	}
+}
+
+//stable LSD radix sort on 8-bit digits, writes the permutation that sorts the keys to perm
+//passes where every key has the same digit are skipped
+template<typename T>
+void radix_sort(const T* keys, size_t n, uint32_t* perm)
+{
+	if(n == 0)
+		return;
+
+	T* keysA = (T*)QM_MALLOC(n * sizeof(T));
+	T* keysB = (T*)QM_MALLOC(n * sizeof(T));
+	uint32_t* permB = (uint32_t*)QM_MALLOC(n * sizeof(uint32_t));
+
+	for(size_t i = 0; i < n; i++)
+	{
+		keysA[i] = keys[i];
+		perm[i] = (uint32_t)i;
+	}
+
+	uint32_t* permA = perm;
+	for(size_t shift = 0; shift < sizeof(T) * 8; shift += 8)
+	{
+		size_t counts[256] = {};
+		for(size_t i = 0; i < n; i++)
+			counts[(keysA[i] >> shift) & 0xFF]++;
+
+		if(counts[(keysA[0] >> shift) & 0xFF] == n)
+			continue;
+
+		size_t offset = 0;
+		for(size_t i = 0; i < 256; i++)
+		{
+			size_t count = counts[i];
+			counts[i] = offset;
+			offset += count;
+		}
+
+		for(size_t i = 0; i < n; i++)
+		{
+			size_t dst = counts[(keysA[i] >> shift) & 0xFF]++;
+			keysB[dst] = keysA[i];
+			permB[dst] = permA[i];
+		}
+
+		T* tmpKeys = keysA;
+		keysA = keysB;
+		keysB = tmpKeys;
+
+		uint32_t* tmpPerm = permA;
+		permA = permB;
+		permB = tmpPerm;
+	}
+
+	//the result may have ended in the scratch buffer:
+	if(permA != perm)
+	{
+		for(size_t i = 0; i < n; i++)
+			perm[i] = permA[i];
+
+		permB = permA;
+	}
+
+	QM_FREE(keysA);
+	QM_FREE(keysB);
+	QM_FREE(permB);
+}
+
+//gathers in[perm[i]] into out[i], for reordering instance arrays (vec3s, quaternions, mat4s, ...) by a sort
+template<typename T>
+void reorder(const T* in, const uint32_t* perm, size_t n, T* out)
+{
+	for(size_t i = 0; i < n; i++)
+		out[i] = in[perm[i]];
+}
+
+//----------------------------------------------------------------------//
+//BOUNDING VOLUME FUNCTIONS:
+
+//bounds of n points, the results over separate ranges can be combined with merge()
+inline aabb compute_aabb(const vec3* points, size_t n)
+{
+	aabb result;
+	size_t i = 0;
+
+	#if QM_USE_SSE
+
+	if(n >= 4)
+	{
+		//4 vec3s are 3 loads, lane k of the 3 accumulators always holds axis k % 3:
+		const float* p = (const float*)points;
+		__m128 minA = _mm_set1_ps(INFINITY);
+		__m128 minB = minA;
+		__m128 minC = minA;
+		__m128 maxA = _mm_set1_ps(-INFINITY);
+		__m128 maxB = maxA;
+		__m128 maxC = maxA;
+
+		for(; i + 4 <= n; i += 4, p += 12)
+		{
+			__m128 a = _mm_loadu_ps(p);
+			__m128 b = _mm_loadu_ps(p + 4);
+			__m128 c = _mm_loadu_ps(p + 8);
+
+			minA = _mm_min_ps(minA, a);
+			minB = _mm_min_ps(minB, b);
+			minC = _mm_min_ps(minC, c);
+			maxA = _mm_max_ps(maxA, a);
+			maxB = _mm_max_ps(maxB, b);
+			maxC = _mm_max_ps(maxC, c);
+		}
+
+		float lo[12];
+		float hi[12];
+		_mm_storeu_ps(lo    , minA);
+		_mm_storeu_ps(lo + 4, minB);
+		_mm_storeu_ps(lo + 8, minC);
+		_mm_storeu_ps(hi    , maxA);
+		_mm_storeu_ps(hi + 4, maxB);
+		_mm_storeu_ps(hi + 8, maxC);
+
+		for(int k = 0; k < 12; k++)
+		{
+			result.min.v[k % 3] = QM_MIN(result.min.v[k % 3], lo[k]);
+			result.max.v[k % 3] = QM_MAX(result.max.v[k % 3], hi[k]);
+		}
+	}
+
+	#endif
+
+	for(; i < n; i++)
+	{
+		result.min = min(result.min, points[i]);
+		result.max = max(result.max, points[i]);
+	}
+
+	return result;
+}
+
+//mean of n points, summed in float blocks that are accumulated as doubles to limit rounding error
+inline vec3 compute_centroid(const vec3* points, size_t n)
+{
+	const size_t BLOCK_SIZE = 1024;
+
+	double sum[3] = {0.0, 0.0, 0.0};
+	if(n == 0)
+		return vec3(0.0f);
+
+	for(size_t start = 0; start < n; start += BLOCK_SIZE)
+	{
+		size_t end = QM_MIN(start + BLOCK_SIZE, n);
+		size_t i = start;
+		float block[12] = {};
+
+		#if QM_USE_SSE
+
+		//same layout as compute_aabb(), lane k accumulates axis k % 3:
+		const float* p = (const float*)(points + i);
+		__m128 sumA = _mm_setzero_ps();
+		__m128 sumB = _mm_setzero_ps();
+		__m128 sumC = _mm_setzero_ps();
+
+		for(; i + 4 <= end; i += 4, p += 12)
+		{
+			sumA = _mm_add_ps(sumA, _mm_loadu_ps(p));
+			sumB = _mm_add_ps(sumB, _mm_loadu_ps(p + 4));
+			sumC = _mm_add_ps(sumC, _mm_loadu_ps(p + 8));
+		}
+
+		_mm_storeu_ps(block    , sumA);
+		_mm_storeu_ps(block + 4, sumB);
+		_mm_storeu_ps(block + 8, sumC);
+
+		#endif
+
+		for(; i < end; i++)
+			for(int k = 0; k < 3; k++)
+				block[k] += points[i].v[k];
+
+		for(int k = 0; k < 12; k++)
+			sum[k % 3] += block[k];
+	}
+
+	return vec3((float)(sum[0] / n), (float)(sum[1] / n), (float)(sum[2] / n));
+}
+
+//index of the point furthest from p
+inline size_t furthest_point(const vec3* points, size_t n, const vec3& p)
+{
+	size_t result = 0;
+	float best = -1.0f;
+	size_t i = 0;
+
+	#if QM_USE_SSE
+
+	if(n >= 4)
+	{
+		vec3x4 center = vec3x4(p);
+		__m128 laneBest = _mm_set1_ps(-1.0f);
+		__m128i laneIndex = _mm_setzero_si128();
+		__m128i index = _mm_setr_epi32(0, 1, 2, 3);
+
+		for(; i + 4 <= n; i += 4)
+		{
+			vec3x4 d = vec3x4(points[i], points[i + 1], points[i + 2], points[i + 3]) - center;
+			__m128 dist = dot(d, d).packed;
+
+			__m128 better = _mm_cmpgt_ps(dist, laneBest);
+			laneBest = _mm_max_ps(dist, laneBest);
+			laneIndex = _mm_or_si128(_mm_and_si128(_mm_castps_si128(better), index), _mm_andnot_si128(_mm_castps_si128(better), laneIndex));
+			index = _mm_add_epi32(index, _mm_set1_epi32(4));
+		}
+
+		float dists[4];
+		uint32_t indices[4];
+		_mm_storeu_ps(dists, laneBest);
+		_mm_storeu_si128((__m128i*)indices, laneIndex);
+
+		for(int lane = 0; lane < 4; lane++)
+			if(dists[lane] > best)
+			{
+				best = dists[lane];
+				result = indices[lane];
+			}
+	}
+
+	#endif
+
+	for(; i < n; i++)
+	{
+		vec3 d = points[i] - p;
+		float dist = dot(d, d);
+		if(dist > best)
+		{
+			best = dist;
+			result = i;
+		}
+	}
+
+	return result;
+}
+
+//grows s to contain each point in turn, visiting them starting from index start
+//4 points are tested at once and only the ones outside cause scalar updates
+inline void grow_sphere(sphere* s, const vec3* points, size_t n, size_t start)
+{
+	for(size_t k = 0; k < n;)
+	{
+		size_t i = (start + k) % n;
+
+		if(k + 4 <= n && i + 4 <= n)
+		{
+			vec3x4 d = vec3x4(points[i], points[i + 1], points[i + 2], points[i + 3]) - vec3x4(s->center);
+			if(mask_lt(vec4(s->radius * s->radius), dot(d, d)) == 0)
+			{
+				k += 4;
+				continue;
+			}
+		}
+
+		vec3 d = points[i] - s->center;
+		float dist2 = dot(d, d);
+		if(dist2 > s->radius * s->radius)
+		{
+			float dist = QM_SQRTF(dist2);
+			float radius = (s->radius + dist) * 0.5f;
+
+			s->center = s->center + d * ((radius - s->radius) / dist);
+			s->radius = radius;
+		}
+
+		k++;
+	}
+}
+
+//a bounding sphere of n points using Ritter's method, then refined by shrinking and regrowing
+//over different visiting orders, keeping the smallest
+inline sphere compute_bounding_sphere(const vec3* points, size_t n, int refinements = 8)
+{
+	if(n == 0)
+		return sphere(vec3(0.0f), 0.0f);
+
+	//start from the 2 points furthest apart along an approximate diameter:
+	vec3 y = points[furthest_point(points, n, points[0])];
+	vec3 z = points[furthest_point(points, n, y)];
+
+	sphere result = sphere((y + z) * 0.5f, distance(y, z) * 0.5f);
+	grow_sphere(&result, points, n, 0);
+
+	for(int i = 0; i < refinements; i++)
+	{
+		sphere s = sphere(result.center, result.radius * 0.95f);
+		grow_sphere(&s, points, n, n * (i + 1) / (refinements + 1));
+
+		if(s.radius < result.radius)
+			result = s;
+	}
+
+	//cover rounding in the incremental updates:
+	result.radius *= 1.0f + 1e-6f;
+	return result;
+}
+
+//----------------------------------------------------------------------//
+//EIGEN FUNCTIONS:
+
+//sorts eigenvalues in descending order, keeping their eigenvector columns with them:
+inline void sort_eigen(vec3* values, mat3* vectors)
+{
+	for(int i = 0; i < 2; i++)
+		for(int j = 0; j < 2 - i; j++)
+			if(values->v[j] < values->v[j + 1])
+			{
+				float tmp = values->v[j];
+				values->v[j] = values->v[j + 1];
+				values->v[j + 1] = tmp;
+
+				vec3 tmpVec = vectors->v[j];
+				vectors->v[j] = vectors->v[j + 1];
+				vectors->v[j + 1] = tmpVec;
+			}
+}
+
+//eigendecomposition of a symmetric matrix with cyclic Jacobi rotations
+//the eigenvalues are written in descending order, with the matching unit eigenvectors as the columns of vectors
+inline void eigen_symmetric(const mat3& m, vec3* values, mat3* vectors)
+{
+	const int MAX_SWEEPS = 16;
+
+	float a[3][3];
+	for(int i = 0; i < 3; i++)
+		for(int j = 0; j < 3; j++)
+			a[i][j] = m.m[i][j];
+
+	mat3 v = mat3_identity();
+
+	for(int sweep = 0; sweep < MAX_SWEEPS; sweep++)
+	{
+		float off = a[0][1] * a[0][1] + a[0][2] * a[0][2] + a[1][2] * a[1][2];
+		float diag = a[0][0] * a[0][0] + a[1][1] * a[1][1] + a[2][2] * a[2][2];
+		if(off <= 1e-14f * diag)
+			break;
+
+		for(int p = 0; p < 2; p++)
+		for(int q = p + 1; q < 3; q++)
+		{
+			if(a[p][q] == 0.0f)
+				continue;
+
+			int r = 3 - p - q;
+
+			float theta = (a[q][q] - a[p][p]) / (2.0f * a[p][q]);
+			float t = (theta >= 0.0f ? 1.0f : -1.0f) / (QM_FABSF(theta) + QM_SQRTF(theta * theta + 1.0f));
+			float c = 1.0f / QM_SQRTF(t * t + 1.0f);
+			float s = t * c;
+
+			float arp = a[r][p];
+			float arq = a[r][q];
+
+			a[p][p] -= t * a[p][q];
+			a[q][q] += t * a[p][q];
+			a[p][q] = a[q][p] = 0.0f;
+			a[r][p] = a[p][r] = c * arp - s * arq;
+			a[r][q] = a[q][r] = s * arp + c * arq;
+
+			for(int k = 0; k < 3; k++)
+			{
+				float vkp = v.m[p][k];
+				float vkq = v.m[q][k];
+				v.m[p][k] = c * vkp - s * vkq;
+				v.m[q][k] = s * vkp + c * vkq;
+			}
+		}
+	}
+
+	*values = vec3(a[0][0], a[1][1], a[2][2]);
+	*vectors = v;
+	sort_eigen(values, vectors);
+}
+
+//cyclic Jacobi on 4 symmetric matrices in SIMD lanes, a[p][q] holds entry (p, q) of each
+//branch-free with a fixed number of sweeps, a is left (nearly) diagonal and v holds the eigenvectors as columns
+inline void jacobi_lanes(vec4 a[3][3], vec4 v[3][3], int sweeps)
+{
+	for(int p = 0; p < 3; p++)
+		for(int q = 0; q < 3; q++)
+			v[p][q] = vec4(p == q ? 1.0f : 0.0f);
+
+	for(int sweep = 0; sweep < sweeps; sweep++)
+	for(int p = 0; p < 2; p++)
+	for(int q = p + 1; q < 3; q++)
+	{
+		int r = 3 - p - q;
+
+		//lanes that are already diagonal get the identity rotation:
+		int zero = mask_le(abs(a[p][q]), vec4(1e-30f));
+		vec4 apq = select(zero, vec4(1.0f), a[p][q]);
+
+		vec4 theta = (a[q][q] - a[p][p]) / (2.0f * apq);
+		vec4 sign = select(mask_lt(theta, vec4(0.0f)), vec4(-1.0f), vec4(1.0f));
+		vec4 t = sign / (abs(theta) + sqrt(theta * theta + vec4(1.0f)));
+		t = select(zero, vec4(0.0f), t);
+
+		vec4 c = 1.0f / sqrt(t * t + vec4(1.0f));
+		vec4 s = t * c;
+
+		vec4 arp = a[r][p];
+		vec4 arq = a[r][q];
+
+		a[p][p] = a[p][p] - t * a[p][q];
+		a[q][q] = a[q][q] + t * a[p][q];
+		a[p][q] = a[q][p] = vec4(0.0f);
+		a[r][p] = a[p][r] = c * arp - s * arq;
+		a[r][q] = a[q][r] = s * arp + c * arq;
+
+		for(int k = 0; k < 3; k++)
+		{
+			vec4 vkp = v[p][k];
+			vec4 vkq = v[q][k];
+			v[p][k] = c * vkp - s * vkq;
+			v[q][k] = s * vkp + c * vkq;
+		}
+	}
+}
+
+//eigendecomposition of n symmetric matrices, 4 at a time in SIMD lanes
+inline void eigen_symmetric(const mat3* m, size_t n, vec3* values, mat3* vectors)
+{
+	const int SWEEPS = 6;
+
+	size_t i = 0;
+	for(; i + 4 <= n; i += 4)
+	{
+		vec4 a[3][3];
+		vec4 v[3][3];
+		for(int p = 0; p < 3; p++)
+			for(int q = 0; q < 3; q++)
+				a[p][q] = vec4(m[i].m[p][q], m[i + 1].m[p][q], m[i + 2].m[p][q], m[i + 3].m[p][q]);
+
+		jacobi_lanes(a, v, SWEEPS);
+
+		for(int lane = 0; lane < 4; lane++)
+		{
+			values[i + lane] = vec3(a[0][0].v[lane], a[1][1].v[lane], a[2][2].v[lane]);
+			for(int p = 0; p < 3; p++)
+				for(int k = 0; k < 3; k++)
+					vectors[i + lane].m[p][k] = v[p][k].v[lane];
+
+			sort_eigen(values + i + lane, vectors + i + lane);
+		}
+	}
+
+	for(; i < n; i++)
+		eigen_symmetric(m[i], values + i, vectors + i);
+}
+
+//covariance matrix of n points in a single pass, optionally writing their mean
+//sums are taken relative to the first point so points far from the origin don't lose precision
+inline mat3 compute_covariance(const vec3* points, size_t n, vec3* mean = nullptr)
+{
+	const size_t BLOCK_SIZE = 1024;
+
+	mat3 result;
+	if(n == 0)
+	{
+		if(mean)
+			*mean = vec3(0.0f);
+
+		return result;
+	}
+
+	vec3 origin = points[0];
+	double sum[3] = {0.0, 0.0, 0.0};
+	double prod[6] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0}; //xx, xy, xz, yy, yz, zz
+
+	vec3x4 origin4 = vec3x4(origin);
+	for(size_t start = 0; start < n; start += BLOCK_SIZE)
+	{
+		size_t end = QM_MIN(start + BLOCK_SIZE, n);
+		size_t i = start;
+
+		vec3x4 s = vec3x4(vec3(0.0f));
+		vec4 xx = vec4(0.0f), xy = vec4(0.0f), xz = vec4(0.0f);
+		vec4 yy = vec4(0.0f), yz = vec4(0.0f), zz = vec4(0.0f);
+
+		for(; i + 4 <= end; i += 4)
+		{
+			vec3x4 p = vec3x4(points[i], points[i + 1], points[i + 2], points[i + 3]) - origin4;
+
+			s = s + p;
+			xx = xx + p.x * p.x;
+			xy = xy + p.x * p.y;
+			xz = xz + p.x * p.z;
+			yy = yy + p.y * p.y;
+			yz = yz + p.y * p.z;
+			zz = zz + p.z * p.z;
+		}
+
+		for(; i < end; i++)
+		{
+			vec3 p = points[i] - origin;
+
+			s.x.x += p.x;
+			s.y.x += p.y;
+			s.z.x += p.z;
+			xx.x += p.x * p.x;
+			xy.x += p.x * p.y;
+			xz.x += p.x * p.z;
+			yy.x += p.y * p.y;
+			yz.x += p.y * p.z;
+			zz.x += p.z * p.z;
+		}
+
+		for(int lane = 0; lane < 4; lane++)
+		{
+			sum[0] += s.x.v[lane];
+			sum[1] += s.y.v[lane];
+			sum[2] += s.z.v[lane];
+			prod[0] += xx.v[lane];
+			prod[1] += xy.v[lane];
+			prod[2] += xz.v[lane];
+			prod[3] += yy.v[lane];
+			prod[4] += yz.v[lane];
+			prod[5] += zz.v[lane];
+		}
+	}
+
+	double mx = sum[0] / n;
+	double my = sum[1] / n;
+	double mz = sum[2] / n;
+
+	float cxx = (float)(prod[0] / n - mx * mx);
+	float cxy = (float)(prod[1] / n - mx * my);
+	float cxz = (float)(prod[2] / n - mx * mz);
+	float cyy = (float)(prod[3] / n - my * my);
+	float cyz = (float)(prod[4] / n - my * mz);
+	float czz = (float)(prod[5] / n - mz * mz);
+
+	result.m[0][0] = cxx; result.m[1][0] = cxy; result.m[2][0] = cxz;
+	result.m[0][1] = cxy; result.m[1][1] = cyy; result.m[2][1] = cyz;
+	result.m[0][2] = cxz; result.m[1][2] = cyz; result.m[2][2] = czz;
+
+	if(mean)
+		*mean = origin + vec3((float)mx, (float)my, (float)mz);
+
+	return result;
+}
+
+//principal axes of n points (columns of axes, by descending variance)
+inline void pca(const vec3* points, size_t n, vec3* mean, mat3* axes, vec3* variances)
+{
+	eigen_symmetric(compute_covariance(points, n, mean), variances, axes);
+}
+
+//an oriented box around n points aligned to their principal axes
+inline obb fit_obb(const vec3* points, size_t n)
+{
+	vec3 mean;
+	vec3 variances;
+	mat3 axes;
+	pca(points, n, &mean, &axes, &variances);
+
+	//keep the axes right-handed so they form a rotation:
+	if(dot(cross(axes.v[0], axes.v[1]), axes.v[2]) < 0.0f)
+		axes.v[2] = -1.0f * axes.v[2];
+
+	vec3 lo = vec3( INFINITY);
+	vec3 hi = vec3(-INFINITY);
+	for(size_t i = 0; i < n; i++)
+	{
+		vec3 d = points[i] - mean;
+		vec3 p = vec3(dot(d, axes.v[0]), dot(d, axes.v[1]), dot(d, axes.v[2]));
+
+		lo = min(lo, p);
+		hi = max(hi, p);
+	}
+
+	if(n == 0)
+		return obb(mean, axes, vec3(0.0f));
+
+	vec3 mid = (lo + hi) * 0.5f;
+	vec3 center = mean + axes.v[0] * mid.x + axes.v[1] * mid.y + axes.v[2] * mid.z;
+	return obb(center, axes, (hi - lo) * 0.5f);
+}
+
+//----------------------------------------------------------------------//
+//SVD FUNCTIONS:
+
+//applies a Givens rotation to rows p and q of 4 matrices in SIMD lanes, zeroing entry (q, col)
+//the transpose of the rotation is accumulated into the columns of u so that b = u * r stays invariant
+inline void givens_lanes(vec4 b[3][3], vec4 u[3][3], int p, int q, int col)
+{
+	vec4 x = b[col][p];
+	vec4 y = b[col][q];
+	vec4 r2 = x * x + y * y;
+
+	//lanes where both entries are zero get the identity rotation:
+	int zero = mask_le(r2, vec4(1e-30f));
+	vec4 invR = 1.0f / sqrt(select(zero, vec4(1.0f), r2));
+	vec4 c = select(zero, vec4(1.0f), x * invR);
+	vec4 s = select(zero, vec4(0.0f), y * invR);
+
+	for(int k = 0; k < 3; k++)
+	{
+		vec4 bp = b[k][p];
+		vec4 bq = b[k][q];
+		b[k][p] = c * bp + s * bq;
+		b[k][q] = c * bq - s * bp;
+
+		vec4 up = u[p][k];
+		vec4 uq = u[q][k];
+		u[p][k] = c * up + s * uq;
+		u[q][k] = c * uq - s * up;
+	}
+}
+
+//swaps columns i and j of b and v in the lanes where column j is longer, negating one to keep v a rotation:
+inline void sort_columns_lanes(vec4 b[3][3], vec4 v[3][3], vec4 rho[3], int i, int j)
+{
+	int swap = mask_lt(rho[i], rho[j]);
+
+	for(int k = 0; k < 3; k++)
+	{
+		vec4 bi = b[i][k];
+		vec4 bj = b[j][k];
+		b[i][k] = select(swap, bj, bi);
+		b[j][k] = select(swap, -1.0f * bi, bj);
+
+		vec4 vi = v[i][k];
+		vec4 vj = v[j][k];
+		v[i][k] = select(swap, vj, vi);
+		v[j][k] = select(swap, -1.0f * vi, vj);
+	}
+
+	vec4 rhoI = rho[i];
+	rho[i] = select(swap, rho[j], rhoI);
+	rho[j] = select(swap, rhoI, rho[j]);
+}
+
+//branch-free SVD of 4 matrices in SIMD lanes, a[c][r] holds entry (r, c) of each (column-major, like mat3)
+//a = u * diag(sigma) * v^T with u and v rotations, sigma[0] >= sigma[1] >= |sigma[2]|,
+//sigma[2] is negative when the determinant is
+//follows McAdams et al.: Jacobi on a^T * a gives v, then QR of a * v with Givens rotations gives u and sigma
+inline void svd_lanes(const vec4 a[3][3], vec4 u[3][3], vec4 sigma[3], vec4 v[3][3])
+{
+	const int SWEEPS = 6;
+
+	vec4 s[3][3];
+	for(int i = 0; i < 3; i++)
+		for(int j = 0; j < 3; j++)
+			s[i][j] = a[i][0] * a[j][0] + a[i][1] * a[j][1] + a[i][2] * a[j][2];
+
+	jacobi_lanes(s, v, SWEEPS);
+
+	//b = a * v:
+	vec4 b[3][3];
+	for(int j = 0; j < 3; j++)
+		for(int k = 0; k < 3; k++)
+			b[j][k] = a[0][k] * v[j][0] + a[1][k] * v[j][1] + a[2][k] * v[j][2];
+
+	//sort by descending column length so the QR below is well-conditioned:
+	vec4 rho[3];
+	for(int j = 0; j < 3; j++)
+		rho[j] = b[j][0] * b[j][0] + b[j][1] * b[j][1] + b[j][2] * b[j][2];
+
+	sort_columns_lanes(b, v, rho, 0, 1);
+	sort_columns_lanes(b, v, rho, 0, 2);
+	sort_columns_lanes(b, v, rho, 1, 2);
+
+	for(int p = 0; p < 3; p++)
+		for(int q = 0; q < 3; q++)
+			u[p][q] = vec4(p == q ? 1.0f : 0.0f);
+
+	givens_lanes(b, u, 0, 1, 0);
+	givens_lanes(b, u, 0, 2, 0);
+	givens_lanes(b, u, 1, 2, 1);
+
+	for(int i = 0; i < 3; i++)
+		sigma[i] = b[i][i];
+}
+
+//singular value decomposition, m = u * diag(sigma) * transpose(v)
+//u and v are rotations, sigma is sorted by descending magnitude and its last entry carries the sign of det(m)
+inline void svd(const mat3& m, mat3* u, vec3* sigma, mat3* v)
+{
+	vec4 a[3][3];
+	for(int i = 0; i < 3; i++)
+		for(int j = 0; j < 3; j++)
+			a[i][j] = vec4(m.m[i][j]);
+
+	vec4 lu[3][3];
+	vec4 ls[3];
+	vec4 lv[3][3];
+	svd_lanes(a, lu, ls, lv);
+
+	for(int i = 0; i < 3; i++)
+	{
+		sigma->v[i] = ls[i].x;
+		for(int j = 0; j < 3; j++)
+		{
+			u->m[i][j] = lu[i][j].x;
+			v->m[i][j] = lv[i][j].x;
+		}
+	}
+}
+
+//singular value decompositions of n matrices, 4 at a time in SIMD lanes
+inline void svd(const mat3* m, size_t n, mat3* u, vec3* sigma, mat3* v)
+{
+	for(size_t i = 0; i < n; i += 4)
+	{
+		size_t count = QM_MIN(n - i, (size_t)4);
+
+		//pad the last group with identities:
+		vec4 a[3][3];
+		for(int p = 0; p < 3; p++)
+			for(int q = 0; q < 3; q++)
+			{
+				a[p][q] = vec4(p == q ? 1.0f : 0.0f);
+				for(size_t lane = 0; lane < count; lane++)
+					a[p][q].v[lane] = m[i + lane].m[p][q];
+			}
+
+		vec4 lu[3][3];
+		vec4 ls[3];
+		vec4 lv[3][3];
+		svd_lanes(a, lu, ls, lv);
+
+		for(size_t lane = 0; lane < count; lane++)
+			for(int p = 0; p < 3; p++)
+			{
+				sigma[i + lane].v[p] = ls[p].v[lane];
+				for(int q = 0; q < 3; q++)
+				{
+					u[i + lane].m[p][q] = lu[p][q].v[lane];
+					v[i + lane].m[p][q] = lv[p][q].v[lane];
+				}
+			}
+	}
+}
+
+//polar decomposition m = rotation * stretch, returns the rotation closest to m and optionally writes the symmetric stretch
+//for shape matching, pass the moment matrix sum((p_i - c) * (q_i - c0)^T) of the deformed and rest positions
+inline mat3 polar_decomposition(const mat3& m, mat3* stretch = nullptr)
+{
+	mat3 u, v;
+	vec3 sigma;
+	svd(m, &u, &sigma, &v);
+
+	mat3 vt = transpose(v);
+	if(stretch)
+	{
+		mat3 vs = v;
+		for(int i = 0; i < 3; i++)
+			vs.v[i] = v.v[i] * sigma.v[i];
+
+		*stretch = vs * vt;
+	}
+
+	return u * vt;
+}
+
+//rotations of the polar decompositions of n matrices, 4 at a time in SIMD lanes
+inline void polar_decomposition(const mat3* m, size_t n, mat3* rotations)
+{
+	for(size_t i = 0; i < n; i += 4)
+	{
+		size_t count = QM_MIN(n - i, (size_t)4);
+
+		vec4 a[3][3];
+		for(int p = 0; p < 3; p++)
+			for(int q = 0; q < 3; q++)
+			{
+				a[p][q] = vec4(p == q ? 1.0f : 0.0f);
+				for(size_t lane = 0; lane < count; lane++)
+					a[p][q].v[lane] = m[i + lane].m[p][q];
+			}
+
+		vec4 u[3][3];
+		vec4 sigma[3];
+		vec4 v[3][3];
+		svd_lanes(a, u, sigma, v);
+
+		//r = u * v^T, entry (row, col) is sum over k of u[k][row] * v[k][col]:
+		for(int col = 0; col < 3; col++)
+			for(int row = 0; row < 3; row++)
+			{
+				vec4 r = u[0][row] * v[0][col] + u[1][row] * v[1][col] + u[2][row] * v[2][col];
+				for(size_t lane = 0; lane < count; lane++)
+					rotations[i + lane].m[col][row] = r.v[lane];
+			}
+	}
+}
+
+//----------------------------------------------------------------------//
+//REGISTRATION FUNCTIONS:
+
+//best-fit rigid transform (Kabsch) mapping source[i] onto target[i], so that target[i] ~= rotation * source[i] + translation
+//the cross-covariance is accumulated in a single pass and its polar rotation is taken with svd()
+inline mat3 kabsch(const vec3* source, const vec3* target, size_t n, vec3* translation = nullptr)
+{
+	const size_t BLOCK_SIZE = 1024;
+
+	if(n == 0)
+	{
+		if(translation)
+			*translation = vec3(0.0f);
+
+		return mat3_identity();
+	}
+
+	//shift by the first pair to avoid cancellation far from the origin:
+	vec3 originS = source[0];
+	vec3 originT = target[0];
+	double sumS[3] = {0.0, 0.0, 0.0};
+	double sumT[3] = {0.0, 0.0, 0.0};
+	double prod[3][3] = {{0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}}; //[source axis][target axis]
+
+	vec3x4 originS4 = vec3x4(originS);
+	vec3x4 originT4 = vec3x4(originT);
+	for(size_t start = 0; start < n; start += BLOCK_SIZE)
+	{
+		size_t end = QM_MIN(start + BLOCK_SIZE, n);
+		size_t i = start;
+
+		vec3x4 ss = vec3x4(vec3(0.0f));
+		vec3x4 st = vec3x4(vec3(0.0f));
+		vec4 p[3][3];
+		for(int c = 0; c < 3; c++)
+			for(int r = 0; r < 3; r++)
+				p[c][r] = vec4(0.0f);
+
+		for(; i + 4 <= end; i += 4)
+		{
+			vec3x4 s = vec3x4(source[i], source[i + 1], source[i + 2], source[i + 3]) - originS4;
+			vec3x4 t = vec3x4(target[i], target[i + 1], target[i + 2], target[i + 3]) - originT4;
+
+			ss = ss + s;
+			st = st + t;
+
+			vec4 sAxes[3] = {s.x, s.y, s.z};
+			vec4 tAxes[3] = {t.x, t.y, t.z};
+			for(int c = 0; c < 3; c++)
+				for(int r = 0; r < 3; r++)
+					p[c][r] = p[c][r] + sAxes[c] * tAxes[r];
+		}
+
+		for(; i < end; i++)
+		{
+			vec3 s = source[i] - originS;
+			vec3 t = target[i] - originT;
+
+			ss.x.x += s.x;
+			ss.y.x += s.y;
+			ss.z.x += s.z;
+			st.x.x += t.x;
+			st.y.x += t.y;
+			st.z.x += t.z;
+
+			for(int c = 0; c < 3; c++)
+				for(int r = 0; r < 3; r++)
+					p[c][r].x += s.v[c] * t.v[r];
+		}
+
+		for(int lane = 0; lane < 4; lane++)
+		{
+			sumS[0] += ss.x.v[lane];
+			sumS[1] += ss.y.v[lane];
+			sumS[2] += ss.z.v[lane];
+			sumT[0] += st.x.v[lane];
+			sumT[1] += st.y.v[lane];
+			sumT[2] += st.z.v[lane];
+
+			for(int c = 0; c < 3; c++)
+				for(int r = 0; r < 3; r++)
+					prod[c][r] += p[c][r].v[lane];
+		}
+	}
+
+	double meanS[3];
+	double meanT[3];
+	for(int i = 0; i < 3; i++)
+	{
+		meanS[i] = sumS[i] / n;
+		meanT[i] = sumT[i] / n;
+	}
+
+	//h = sum((t - meanT) * (s - meanS)^T), column c holds the source axis:
+	mat3 h;
+	for(int c = 0; c < 3; c++)
+		for(int r = 0; r < 3; r++)
+			h.m[c][r] = (float)(prod[c][r] / n - meanS[c] * meanT[r]);
+
+	mat3 result = polar_decomposition(h);
+
+	if(translation)
+	{
+		vec3 centroidS = originS + vec3((float)meanS[0], (float)meanS[1], (float)meanS[2]);
+		vec3 centroidT = originT + vec3((float)meanT[0], (float)meanT[1], (float)meanT[2]);
+		*translation = centroidT - result * centroidS;
+	}
+
+	return result;
+}
+
+//iterative closest point, aligns source to the primitives of target (boxes or triangles)
+//rotation and translation hold the initial guess and receive the result, pairs further than maxDistance are rejected
+//stops when the RMS distance changes by less than tolerance, returns the RMS distance of the last correspondences
+inline float icp(const vec3* source, size_t n, const bvh& target, mat3* rotation, vec3* translation,
+                 int maxIterations = 32, float maxDistance = INFINITY, float tolerance = 1e-6f)
+{
+	float result = INFINITY;
+	if(n == 0)
+		return result;
+
+	vec3* matchedSource = (vec3*)QM_MALLOC(n * sizeof(vec3));
+	vec3* matchedTarget = (vec3*)QM_MALLOC(n * sizeof(vec3));
+	float maxDistSq = maxDistance * maxDistance;
+
+	for(int iter = 0; iter < maxIterations; iter++)
+	{
+		mat3 rot = *rotation;
+		vec3 trans = *translation;
+
+		size_t count = 0;
+		double errorSum = 0.0;
+		for(size_t i = 0; i < n; i++)
+		{
+			vec3 p = rot * source[i] + trans;
+
+			float distSq = maxDistSq;
+			int prim = target.nearest(p, &distSq);
+			if(prim < 0)
+				continue;
+
+			vec3 q;
+			if(target.vertices)
+			{
+				vec3 a, b, c;
+				target.triangle((uint32_t)prim, &a, &b, &c);
+				q = closest_point_on_triangle(p, a, b, c);
+			}
+			else
+				q = closest_point(target.primBoxes[prim], p);
+
+			matchedSource[count] = source[i];
+			matchedTarget[count] = q;
+			count++;
+			errorSum += distSq;
+		}
+
+		//too few pairs to constrain a rigid transform:
+		if(count < 3)
+			break;
+
+		float error = QM_SQRTF((float)(errorSum / count));
+		*rotation = kabsch(matchedSource, matchedTarget, count, translation);
+
+		bool converged = QM_FABSF(result - error) <= tolerance;
+		result = error;
+		if(converged)
+			break;
+	}
+
+	QM_FREE(matchedSource);
+	QM_FREE(matchedTarget);
+	return result;
+}
+
+//----------------------------------------------------------------------//
+//GENERIC FUNCTIONS:
+//defined for any vec<N, T>, mat<R, C, T> and qua<T>, overload resolution picks
+//the hand-written float functions above whenever they match exactly
+
+#if QM_INCLUDE_IOSTREAM
+
+template<int N, typename T>
+inline std::ostream& operator<<(std::ostream& os, const vec<N, T>& v)
+{
+	for(int i = 0; i < N; i++)
+		os << (i > 0 ? ", " : "") << v.v[i];
+
+	return os;
+}
+
+template<int N, typename T>
+inline std::istream& operator>>(std::istream& is, vec<N, T>& v)
+{
+	for(int i = 0; i < N; i++)
+		is >> v.v[i];
+
+	return is;
+}
+
+#endif
+
+//vector arithmetic:
+
+template<int N, typename T>
+inline vec<N, T> operator+(const vec<N, T>& v1, const vec<N, T>& v2)
+{
+	vec<N, T> result;
+
+	for(int i = 0; i < N; i++)
+		result.v[i] = v1.v[i] + v2.v[i];
+
+	return result;
+}
+
+template<int N, typename T>
+inline vec<N, T> operator-(const vec<N, T>& v1, const vec<N, T>& v2)
+{
+	vec<N, T> result;
+
+	for(int i = 0; i < N; i++)
+		result.v[i] = v1.v[i] - v2.v[i];
+
+	return result;
+}
+
+template<int N, typename T>
+inline vec<N, T> operator*(const vec<N, T>& v1, const vec<N, T>& v2)
+{
+	vec<N, T> result;
+
+	for(int i = 0; i < N; i++)
+		result.v[i] = v1.v[i] * v2.v[i];
+
+	return result;
+}
+
+template<int N, typename T>
+inline vec<N, T> operator/(const vec<N, T>& v1, const vec<N, T>& v2)
+{
+	vec<N, T> result;
+
+	for(int i = 0; i < N; i++)
+		result.v[i] = v1.v[i] / v2.v[i];
+
+	return result;
+}
+
+template<int N, typename T>
+inline vec<N, T> operator*(const vec<N, T>& v, T s)
+{
+	vec<N, T> result;
+
+	for(int i = 0; i < N; i++)
+		result.v[i] = v.v[i] * s;
+
+	return result;
+}
+
+template<int N, typename T>
+inline vec<N, T> operator*(T s, const vec<N, T>& v)
+{
+	return v * s;
+}
+
+template<int N, typename T>
+inline vec<N, T> operator/(const vec<N, T>& v, T s)
+{
+	vec<N, T> result;
+
+	for(int i = 0; i < N; i++)
+		result.v[i] = v.v[i] / s;
+
+	return result;
+}
+
+template<int N, typename T>
+inline vec<N, T> operator/(T s, const vec<N, T>& v)
+{
+	vec<N, T> result;
+
+	for(int i = 0; i < N; i++)
+		result.v[i] = s / v.v[i];
+
+	return result;
+}
+
+//vector equality:
+
+template<int N, typename T>
+inline bool operator==(const vec<N, T>& v1, const vec<N, T>& v2)
+{
+	bool result = true;
+
+	for(int i = 0; i < N; i++)
+		result = result && (v1.v[i] == v2.v[i]);
+
+	return result;
+}
+
+template<int N, typename T>
+inline bool operator!=(const vec<N, T>& v1, const vec<N, T>& v2)
+{
+	return !(v1 == v2);
+}
+
+//vector functions:
+
+template<int N, typename T>
+inline T dot(const vec<N, T>& v1, const vec<N, T>& v2)
+{
+	T result = 0;
+
+	for(int i = 0; i < N; i++)
+		result += v1.v[i] * v2.v[i];
+
+	return result;
+}
+
+template<typename T>
+inline vec<3, T> cross(const vec<3, T>& v1, const vec<3, T>& v2)
+{
+	vec<3, T> result;
+
+	result.x = (v1.y * v2.z) - (v1.z * v2.y);
+	result.y = (v1.z * v2.x) - (v1.x * v2.z);
+	result.z = (v1.x * v2.y) - (v1.y * v2.x);
+
+	return result;
+}
+
+template<int N, typename T>
+inline T length(const vec<N, T>& v)
+{
+	return (T)QM_SQRT((double)dot(v, v));
+}
+
+template<int N, typename T>
+inline vec<N, T> normalize(const vec<N, T>& v)
+{
+	vec<N, T> result;
+
+	T len = length(v);
+	if(len != (T)0)
+		result = v / len;
+
+	return result;
+}
+
+template<int N, typename T>
+inline T distance(const vec<N, T>& v1, const vec<N, T>& v2)
+{
+	return length(v1 - v2);
+}
+
+template<int N, typename T>
+inline vec<N, T> min(const vec<N, T>& v1, const vec<N, T>& v2)
+{
+	vec<N, T> result;
+
+	for(int i = 0; i < N; i++)
+		result.v[i] = QM_MIN(v1.v[i], v2.v[i]);
+
+	return result;
+}
+
+template<int N, typename T>
+inline vec<N, T> max(const vec<N, T>& v1, const vec<N, T>& v2)
+{
+	vec<N, T> result;
+
+	for(int i = 0; i < N; i++)
+		result.v[i] = QM_MAX(v1.v[i], v2.v[i]);
+
+	return result;
+}
+
+template<int N, typename T>
+inline vec<N, T> lerp(const vec<N, T>& v1, const vec<N, T>& v2, T a)
+{
+	return v1 + (v2 - v1) * a;
+}
+
+//matrix functions:
+
+template<int N, typename T>
+inline mat<N, N, T> mat_identity()
+{
+	mat<N, N, T> result;
+
+	for(int i = 0; i < N; i++)
+		result.m[i][i] = (T)1;
+
+	return result;
+}
+
+template<int R, int C, typename T>
+inline mat<R, C, T> operator+(const mat<R, C, T>& m1, const mat<R, C, T>& m2)
+{
+	mat<R, C, T> result;
+
+	for(int i = 0; i < C; i++)
+		for(int j = 0; j < R; j++)
+			result.m[i][j] = m1.m[i][j] + m2.m[i][j];
+
+	return result;
+}
+
+template<int R, int C, typename T>
+inline mat<R, C, T> operator-(const mat<R, C, T>& m1, const mat<R, C, T>& m2)
+{
+	mat<R, C, T> result;
+
+	for(int i = 0; i < C; i++)
+		for(int j = 0; j < R; j++)
+			result.m[i][j] = m1.m[i][j] - m2.m[i][j];
+
+	return result;
+}
+
+template<int R, int K, int C, typename T>
+inline mat<R, C, T> operator*(const mat<R, K, T>& m1, const mat<K, C, T>& m2)
+{
+	mat<R, C, T> result;
+
+	for(int i = 0; i < C; i++)
+		for(int j = 0; j < R; j++)
+		{
+			T sum = 0;
+			for(int k = 0; k < K; k++)
+				sum += m1.m[k][j] * m2.m[i][k];
+
+			result.m[i][j] = sum;
+		}
+
+	return result;
+}
+
+template<int R, int C, typename T>
+inline vec<R, T> operator*(const mat<R, C, T>& m, const vec<C, T>& v)
+{
+	vec<R, T> result;
+
+	for(int j = 0; j < R; j++)
+	{
+		T sum = 0;
+		for(int k = 0; k < C; k++)
+			sum += m.m[k][j] * v.v[k];
+
+		result.v[j] = sum;
+	}
+
+	return result;
+}
+
+template<int R, int C, typename T>
+inline mat<C, R, T> transpose(const mat<R, C, T>& m)
+{
+	mat<C, R, T> result;
+
+	for(int i = 0; i < C; i++)
+		for(int j = 0; j < R; j++)
+			result.m[j][i] = m.m[i][j];
+
+	return result;
+}
+
+//quaternion functions:
+
+template<typename T>
+inline qua<T> qua_identity()
+{
+	return qua<T>((T)0, (T)0, (T)0, (T)1);
+}
+
+template<typename T>
+inline qua<T> operator+(const qua<T>& q1, const qua<T>& q2)
+{
+	return qua<T>(q1.x + q2.x, q1.y + q2.y, q1.z + q2.z, q1.w + q2.w);
+}
+
+template<typename T>
+inline qua<T> operator-(const qua<T>& q1, const qua<T>& q2)
+{
+	return qua<T>(q1.x - q2.x, q1.y - q2.y, q1.z - q2.z, q1.w - q2.w);
+}
+
+template<typename T>
+inline qua<T> operator*(const qua<T>& q1, const qua<T>& q2)
+{
+	qua<T> result;
+
+	result.x = q1.w * q2.x + q1.x * q2.w + q1.y * q2.z - q1.z * q2.y;
+	result.y = q1.w * q2.y - q1.x * q2.z + q1.y * q2.w + q1.z * q2.x;
+	result.z = q1.w * q2.z + q1.x * q2.y - q1.y * q2.x + q1.z * q2.w;
+	result.w = q1.w * q2.w - q1.x * q2.x - q1.y * q2.y - q1.z * q2.z;
+
+	return result;
+}
+
+template<typename T>
+inline qua<T> operator*(const qua<T>& q, T s)
+{
+	return qua<T>(q.x * s, q.y * s, q.z * s, q.w * s);
+}
+
+template<typename T>
+inline qua<T> operator*(T s, const qua<T>& q)
+{
+	return q * s;
+}
+
+template<typename T>
+inline qua<T> operator/(const qua<T>& q, T s)
+{
+	return qua<T>(q.x / s, q.y / s, q.z / s, q.w / s);
+}
+
+template<typename T>
+inline bool operator==(const qua<T>& q1, const qua<T>& q2)
+{
+	return (q1.x == q2.x) && (q1.y == q2.y) && (q1.z == q2.z) && (q1.w == q2.w);
+}
+
+template<typename T>
+inline bool operator!=(const qua<T>& q1, const qua<T>& q2)
+{
+	return !(q1 == q2);
+}
+
+template<typename T>
+inline T dot(const qua<T>& q1, const qua<T>& q2)
+{
+	return q1.x * q2.x + q1.y * q2.y + q1.z * q2.z + q1.w * q2.w;
+}
+
+template<typename T>
+inline T length(const qua<T>& q)
+{
+	return (T)QM_SQRT((double)dot(q, q));
+}
+
+template<typename T>
+inline qua<T> normalize(const qua<T>& q)
+{
+	qua<T> result;
+
+	T len = length(q);
+	if(len != (T)0)
+		result = q / len;
+
+	return result;
+}
+
+template<typename T>
+inline qua<T> conjugate(const qua<T>& q)
+{
+	return qua<T>(-q.x, -q.y, -q.z, q.w);
+}
+
+template<typename T>
+inline qua<T> inverse(const qua<T>& q)
+{
+	return conjugate(q) / dot(q, q);
+}
+
+//----------------------------------------------------------------------//
+//DOUBLE PRECISION FUNCTIONS:
+//AVX versions of the dvec4, dmat4 and dquaternion operators, the remaining
+//functions (length, normalize, inverse, ...) come from the generic section above
+
+//dvec4 arithmetic:
+
+inline dvec4 operator+(const dvec4& v1, const dvec4& v2)
+{
+	dvec4 result;
+
+	#if QM_USE_AVX
+
+	result.packed = _mm256_add_pd(v1.packed, v2.packed);
+
+	#else
+
+	result.x = v1.x + v2.x;
+	result.y = v1.y + v2.y;
+	result.z = v1.z + v2.z;
+	result.w = v1.w + v2.w;
+
+	#endif
+
+	return result;
+}
+
+inline dvec4 operator-(const dvec4& v1, const dvec4& v2)
+{
+	dvec4 result;
+
+	#if QM_USE_AVX
+
+	result.packed = _mm256_sub_pd(v1.packed, v2.packed);
+
+	#else
+
+	result.x = v1.x - v2.x;
+	result.y = v1.y - v2.y;
+	result.z = v1.z - v2.z;
+	result.w = v1.w - v2.w;
+
+	#endif
+
+	return result;
+}
+
+inline dvec4 operator*(const dvec4& v1, const dvec4& v2)
+{
+	dvec4 result;
+
+	#if QM_USE_AVX
+
+	result.packed = _mm256_mul_pd(v1.packed, v2.packed);
+
+	#else
+
+	result.x = v1.x * v2.x;
+	result.y = v1.y * v2.y;
+	result.z = v1.z * v2.z;
+	result.w = v1.w * v2.w;
+
+	#endif
+
+	return result;
+}
+
+inline dvec4 operator/(const dvec4& v1, const dvec4& v2)
+{
+	dvec4 result;
+
+	#if QM_USE_AVX
+
+	result.packed = _mm256_div_pd(v1.packed, v2.packed);
+
+	#else
+
+	result.x = v1.x / v2.x;
+	result.y = v1.y / v2.y;
+	result.z = v1.z / v2.z;
+	result.w = v1.w / v2.w;
+
+	#endif
+
+	return result;
+}
+
+inline dvec4 operator*(const dvec4& v, double s)
+{
+	return v * dvec4(s);
+}
+
+inline dvec4 operator*(double s, const dvec4& v)
+{
+	return dvec4(s) * v;
+}
+
+inline dvec4 operator/(const dvec4& v, double s)
+{
+	return v / dvec4(s);
+}
+
+inline dvec4 operator/(double s, const dvec4& v)
+{
+	return dvec4(s) / v;
+}
+
+inline double dot(const dvec4& v1, const dvec4& v2)
+{
+	double result;
+
+	#if QM_USE_AVX
+
+	__m256d prod = _mm256_mul_pd(v1.packed, v2.packed);
+	__m128d sum = _mm_add_pd(_mm256_castpd256_pd128(prod), _mm256_extractf128_pd(prod, 1));
+	result = _mm_cvtsd_f64(_mm_hadd_pd(sum, sum));
+
+	#else
+
+	result = v1.x * v2.x + v1.y * v2.y + v1.z * v2.z + v1.w * v2.w;
+
+	#endif
+
+	return result;
+}
+
+//dmat4 functions:
+
+inline dmat4 dmat4_identity()
+{
+	dmat4 result;
+
+	result.m[0][0] = 1.0;
+	result.m[1][1] = 1.0;
+	result.m[2][2] = 1.0;
+	result.m[3][3] = 1.0;
+
+	return result;
+}
+
+inline dmat4 operator+(const dmat4& m1, const dmat4& m2)
+{
+	dmat4 result;
+
+	for(int i = 0; i < 4; i++)
+		result.v[i] = m1.v[i] + m2.v[i];
+
+	return result;
+}
+
+inline dmat4 operator-(const dmat4& m1, const dmat4& m2)
+{
+	dmat4 result;
+
+	for(int i = 0; i < 4; i++)
+		result.v[i] = m1.v[i] - m2.v[i];
+
+	return result;
+}
+
+inline dvec4 operator*(const dmat4& m, const dvec4& v)
+{
+	dvec4 result;
+
+	#if QM_USE_AVX
+
+	__m256d sum = _mm256_mul_pd(m.packed[0], _mm256_set1_pd(v.x));
+	sum = _mm256_add_pd(sum, _mm256_mul_pd(m.packed[1], _mm256_set1_pd(v.y)));
+	sum = _mm256_add_pd(sum, _mm256_mul_pd(m.packed[2], _mm256_set1_pd(v.z)));
+	sum = _mm256_add_pd(sum, _mm256_mul_pd(m.packed[3], _mm256_set1_pd(v.w)));
+	result.packed = sum;
+
+	#else
+
+	result.x = m.m[0][0] * v.x + m.m[1][0] * v.y + m.m[2][0] * v.z + m.m[3][0] * v.w;
+	result.y = m.m[0][1] * v.x + m.m[1][1] * v.y + m.m[2][1] * v.z + m.m[3][1] * v.w;
+	result.z = m.m[0][2] * v.x + m.m[1][2] * v.y + m.m[2][2] * v.z + m.m[3][2] * v.w;
+	result.w = m.m[0][3] * v.x + m.m[1][3] * v.y + m.m[2][3] * v.z + m.m[3][3] * v.w;
+
+	#endif
+
+	return result;
+}
+
+inline dmat4 operator*(const dmat4& m1, const dmat4& m2)
+{
+	dmat4 result;
+
+	for(int i = 0; i < 4; i++)
+		result.v[i] = m1 * m2.v[i];
+
+	return result;
+}
+
+//dquaternion functions:
+
+inline dquaternion operator+(const dquaternion& q1, const dquaternion& q2)
+{
+	dquaternion result;
+
+	#if QM_USE_AVX
+
+	result.packed = _mm256_add_pd(q1.packed, q2.packed);
+
+	#else
+
+	result.x = q1.x + q2.x;
+	result.y = q1.y + q2.y;
+	result.z = q1.z + q2.z;
+	result.w = q1.w + q2.w;
+
+	#endif
+
+	return result;
+}
+
+inline dquaternion operator-(const dquaternion& q1, const dquaternion& q2)
+{
+	dquaternion result;
+
+	#if QM_USE_AVX
+
+	result.packed = _mm256_sub_pd(q1.packed, q2.packed);
+
+	#else
+
+	result.x = q1.x - q2.x;
+	result.y = q1.y - q2.y;
+	result.z = q1.z - q2.z;
+	result.w = q1.w - q2.w;
+
+	#endif
+
+	return result;
+}
+
+inline dquaternion operator*(const dquaternion& q1, const dquaternion& q2)
+{
+	dquaternion result;
+
+	#if QM_USE_AVX
+
+	__m256d zwxy = _mm256_permute2f128_pd(q2.packed, q2.packed, 1);
+	__m256d wzyx = _mm256_permute_pd(zwxy, 5);
+	__m256d yxwz = _mm256_permute_pd(q2.packed, 5);
+
+	__m256d sum = _mm256_mul_pd(_mm256_set1_pd(q1.w), q2.packed);
+	sum = _mm256_add_pd(sum, _mm256_mul_pd(_mm256_setr_pd( q1.x, -q1.x,  q1.x, -q1.x), wzyx));
+	sum = _mm256_add_pd(sum, _mm256_mul_pd(_mm256_setr_pd( q1.y,  q1.y, -q1.y, -q1.y), zwxy));
+	sum = _mm256_add_pd(sum, _mm256_mul_pd(_mm256_setr_pd(-q1.z,  q1.z,  q1.z, -q1.z), yxwz));
+	result.packed = sum;
+
+	#else
+
+	result.x = q1.w * q2.x + q1.x * q2.w + q1.y * q2.z - q1.z * q2.y;
+	result.y = q1.w * q2.y - q1.x * q2.z + q1.y * q2.w + q1.z * q2.x;
+	result.z = q1.w * q2.z + q1.x * q2.y - q1.y * q2.x + q1.z * q2.w;
+	result.w = q1.w * q2.w - q1.x * q2.x - q1.y * q2.y - q1.z * q2.z;
+
+	#endif
+
+	return result;
+}
+
+inline dquaternion operator*(const dquaternion& q, double s)
+{
+	dquaternion result;
+
+	#if QM_USE_AVX
+
+	result.packed = _mm256_mul_pd(q.packed, _mm256_set1_pd(s));
+
+	#else
+
+	result.x = q.x * s;
+	result.y = q.y * s;
+	result.z = q.z * s;
+	result.w = q.w * s;
+
+	#endif
+
+	return result;
+}
+
+inline dquaternion operator*(double s, const dquaternion& q)
+{
+	return q * s;
+}
+
+inline dquaternion operator/(const dquaternion& q, double s)
+{
+	return q * (1.0 / s);
+}
+
+inline double dot(const dquaternion& q1, const dquaternion& q2)
+{
+	return dot(dvec4(q1.x, q1.y, q1.z, q1.w), dvec4(q2.x, q2.y, q2.z, q2.w));
+}
+
+//camera-relative rebasing:
+
+//writes positions[i] - origin as floats, keeping precision for large world coordinates near the origin
+inline void rebase(const dvec3* positions, const dvec3& origin, vec3* out, size_t n)
+{
+	size_t i = 0;
+
+	#if QM_USE_AVX
+
+	//4 dvec3s are 12 contiguous doubles, converted to 12 contiguous floats:
+	const double* in = (const double*)positions;
+	float* dst = (float*)out;
+
+	__m256d o0 = _mm256_setr_pd(origin.x, origin.y, origin.z, origin.x);
+	__m256d o1 = _mm256_setr_pd(origin.y, origin.z, origin.x, origin.y);
+	__m256d o2 = _mm256_setr_pd(origin.z, origin.x, origin.y, origin.z);
+
+	for(; i + 4 <= n; i += 4)
+	{
+		const double* src = in + i * 3;
+		__m128 a = _mm256_cvtpd_ps(_mm256_sub_pd(_mm256_loadu_pd(src    ), o0));
+		__m128 b = _mm256_cvtpd_ps(_mm256_sub_pd(_mm256_loadu_pd(src + 4), o1));
+		__m128 c = _mm256_cvtpd_ps(_mm256_sub_pd(_mm256_loadu_pd(src + 8), o2));
+
+		_mm_storeu_ps(dst + i * 3    , a);
+		_mm_storeu_ps(dst + i * 3 + 4, b);
+		_mm_storeu_ps(dst + i * 3 + 8, c);
+	}
+
+	#elif QM_USE_SSE
+
+	const double* in = (const double*)positions;
+	float* dst = (float*)out;
+
+	__m128d o0 = _mm_setr_pd(origin.x, origin.y);
+	__m128d o1 = _mm_setr_pd(origin.z, origin.x);
+	__m128d o2 = _mm_setr_pd(origin.y, origin.z);
+
+	for(; i + 4 <= n; i += 4)
+	{
+		const double* src = in + i * 3;
+		__m128 a = _mm_cvtpd_ps(_mm_sub_pd(_mm_loadu_pd(src     ), o0));
+		__m128 b = _mm_cvtpd_ps(_mm_sub_pd(_mm_loadu_pd(src +  2), o1));
+		__m128 c = _mm_cvtpd_ps(_mm_sub_pd(_mm_loadu_pd(src +  4), o2));
+		__m128 d = _mm_cvtpd_ps(_mm_sub_pd(_mm_loadu_pd(src +  6), o0));
+		__m128 e = _mm_cvtpd_ps(_mm_sub_pd(_mm_loadu_pd(src +  8), o1));
+		__m128 f = _mm_cvtpd_ps(_mm_sub_pd(_mm_loadu_pd(src + 10), o2));
+
+		_mm_storeu_ps(dst + i * 3    , _mm_movelh_ps(a, b));
+		_mm_storeu_ps(dst + i * 3 + 4, _mm_movelh_ps(c, d));
+		_mm_storeu_ps(dst + i * 3 + 8, _mm_movelh_ps(e, f));
+	}
+
+	#endif
+
+	for(; i < n; i++)
+	{
+		out[i].x = (float)(positions[i].x - origin.x);
+		out[i].y = (float)(positions[i].y - origin.y);
+		out[i].z = (float)(positions[i].z - origin.z);
+	}
+}
+
+//converts a world matrix to a float matrix whose translation is relative to origin
+inline mat4 rebase(const dmat4& m, const dvec3& origin)
+{
+	mat4 result;
+
+	for(int i = 0; i < 4; i++)
+		for(int j = 0; j < 4; j++)
+			result.m[i][j] = (float)m.m[i][j];
+
+	result.m[3][0] = (float)(m.m[3][0] - origin.x * m.m[3][3]);
+	result.m[3][1] = (float)(m.m[3][1] - origin.y * m.m[3][3]);
+	result.m[3][2] = (float)(m.m[3][2] - origin.z * m.m[3][3]);
+
+	return result;
+}
+
+//----------------------------------------------------------------------//
+//INTEGER VECTOR FUNCTIONS:
+//SIMD versions of the ivec4 and uvec4 operators, ivec2/ivec3/uvec2/uvec3 use the generic functions
+
+//bitwise operators, for any integer vec<N, T>:
+
+template<int N, typename T>
+inline vec<N, T> operator&(const vec<N, T>& v1, const vec<N, T>& v2)
+{
+	vec<N, T> result;
+
+	for(int i = 0; i < N; i++)
+		result.v[i] = v1.v[i] & v2.v[i];
+
+	return result;
+}
+
+template<int N, typename T>
+inline vec<N, T> operator|(const vec<N, T>& v1, const vec<N, T>& v2)
+{
+	vec<N, T> result;
+
+	for(int i = 0; i < N; i++)
+		result.v[i] = v1.v[i] | v2.v[i];
+
+	return result;
+}
+
+template<int N, typename T>
+inline vec<N, T> operator^(const vec<N, T>& v1, const vec<N, T>& v2)
+{
+	vec<N, T> result;
+
+	for(int i = 0; i < N; i++)
+		result.v[i] = v1.v[i] ^ v2.v[i];
+
+	return result;
+}
+
+template<int N, typename T>
+inline vec<N, T> operator<<(const vec<N, T>& v, int s)
+{
+	vec<N, T> result;
+
+	for(int i = 0; i < N; i++)
+		result.v[i] = v.v[i] << s;
+
+	return result;
+}
+
+template<int N, typename T>
+inline vec<N, T> operator>>(const vec<N, T>& v, int s)
+{
+	vec<N, T> result;
+
+	for(int i = 0; i < N; i++)
+		result.v[i] = v.v[i] >> s;
+
+	return result;
+}
+
+#if QM_USE_SSE
+
+//low 32 bits of the lane-wise product, identical for signed and unsigned lanes:
+inline __m128i mullo_epi32_sse(__m128i a, __m128i b)
+{
+	#if QM_USE_SSE4_1
+
+	return _mm_mullo_epi32(a, b);
+
+	#else
+
+	__m128i even = _mm_mul_epu32(a, b);
+	__m128i odd  = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+	return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+
+	#endif
+}
+
+//selects a in lanes where mask is all ones, and b elsewhere:
+inline __m128i blend_epi32_sse(__m128i mask, __m128i a, __m128i b)
+{
+	return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+//flips the sign bits so unsigned lanes can be compared with the signed compares:
+inline __m128i unsigned_bias_sse(__m128i a)
+{
+	return _mm_xor_si128(a, _mm_set1_epi32((int32_t)0x80000000));
+}
+
+#endif
+
+//ivec4 arithmetic:
+
+inline ivec4 operator+(const ivec4& v1, const ivec4& v2)
+{
+	ivec4 result;
+
+	#if QM_USE_SSE
+
+	result.packed = _mm_add_epi32(v1.packed, v2.packed);
+
+	#else
+
+	for(int i = 0; i < 4; i++)
+		result.v[i] = v1.v[i] + v2.v[i];
+
+	#endif
+
+	return result;
+}
+
+inline ivec4 operator-(const ivec4& v1, const ivec4& v2)
+{
+	ivec4 result;
+
+	#if QM_USE_SSE
+
+	result.packed = _mm_sub_epi32(v1.packed, v2.packed);
+
+	#else
+
+	for(int i = 0; i < 4; i++)
+		result.v[i] = v1.v[i] - v2.v[i];
+
+	#endif
+
+	return result;
+}
+
+inline ivec4 operator*(const ivec4& v1, const ivec4& v2)
+{
+	ivec4 result;
+
+	#if QM_USE_SSE
+
+	result.packed = mullo_epi32_sse(v1.packed, v2.packed);
+
+	#else
+
+	for(int i = 0; i < 4; i++)
+		result.v[i] = v1.v[i] * v2.v[i];
+
+	#endif
+
+	return result;
+}
+
+inline ivec4 operator*(const ivec4& v, int32_t s)
+{
+	return v * ivec4(s);
+}
+
+inline ivec4 operator*(int32_t s, const ivec4& v)
+{
+	return ivec4(s) * v;
+}
+
+inline ivec4 operator&(const ivec4& v1, const ivec4& v2)
+{
+	ivec4 result;
+
+	#if QM_USE_SSE
+
+	result.packed = _mm_and_si128(v1.packed, v2.packed);
+
+	#else
+
+	for(int i = 0; i < 4; i++)
+		result.v[i] = v1.v[i] & v2.v[i];
+
+	#endif
+
+	return result;
+}
+
+inline ivec4 operator|(const ivec4& v1, const ivec4& v2)
+{
+	ivec4 result;
+
+	#if QM_USE_SSE
+
+	result.packed = _mm_or_si128(v1.packed, v2.packed);
+
+	#else
+
+	for(int i = 0; i < 4; i++)
+		result.v[i] = v1.v[i] | v2.v[i];
+
+	#endif
+
+	return result;
+}
+
+inline ivec4 operator^(const ivec4& v1, const ivec4& v2)
+{
+	ivec4 result;
+
+	#if QM_USE_SSE
+
+	result.packed = _mm_xor_si128(v1.packed, v2.packed);
+
+	#else
+
+	for(int i = 0; i < 4; i++)
+		result.v[i] = v1.v[i] ^ v2.v[i];
+
+	#endif
+
+	return result;
+}
+
+inline ivec4 operator<<(const ivec4& v, int s)
+{
+	ivec4 result;
+
+	#if QM_USE_SSE
+
+	result.packed = _mm_sll_epi32(v.packed, _mm_cvtsi32_si128(s));
+
+	#else
+
+	for(int i = 0; i < 4; i++)
+		result.v[i] = (int32_t)((uint32_t)v.v[i] << s);
+
+	#endif
+
+	return result;
+}
+
+//arithmetic shift, keeps the sign:
+inline ivec4 operator>>(const ivec4& v, int s)
+{
+	ivec4 result;
+
+	#if QM_USE_SSE
+
+	result.packed = _mm_sra_epi32(v.packed, _mm_cvtsi32_si128(s));
+
+	#else
+
+	for(int i = 0; i < 4; i++)
+		result.v[i] = v.v[i] >> s;
+
+	#endif
+
+	return result;
+}
+
+inline ivec4 min(const ivec4& v1, const ivec4& v2)
+{
+	ivec4 result;
+
+	#if QM_USE_SSE4_1
+
+	result.packed = _mm_min_epi32(v1.packed, v2.packed);
+
+	#elif QM_USE_SSE
+
+	result.packed = blend_epi32_sse(_mm_cmplt_epi32(v1.packed, v2.packed), v1.packed, v2.packed);
+
+	#else
+
+	for(int i = 0; i < 4; i++)
+		result.v[i] = QM_MIN(v1.v[i], v2.v[i]);
+
+	#endif
+
+	return result;
+}
+
+inline ivec4 max(const ivec4& v1, const ivec4& v2)
+{
+	ivec4 result;
+
+	#if QM_USE_SSE4_1
+
+	result.packed = _mm_max_epi32(v1.packed, v2.packed);
+
+	#elif QM_USE_SSE
+
+	result.packed = blend_epi32_sse(_mm_cmpgt_epi32(v1.packed, v2.packed), v1.packed, v2.packed);
+
+	#else
+
+	for(int i = 0; i < 4; i++)
+		result.v[i] = QM_MAX(v1.v[i], v2.v[i]);
+
+	#endif
+
+	return result;
+}
+
+//ivec4 comparisons, returning a 4-bit lane mask like the vec4 versions:
+
+inline int mask_eq(const ivec4& v1, const ivec4& v2)
+{
+	int result;
+
+	#if QM_USE_SSE
+
+	result = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(v1.packed, v2.packed)));
+
+	#else
+
+	result = (v1.x == v2.x) | (v1.y == v2.y) << 1 | (v1.z == v2.z) << 2 | (v1.w == v2.w) << 3;
+
+	#endif
+
+	return result;
+}
+
+inline int mask_lt(const ivec4& v1, const ivec4& v2)
+{
+	int result;
+
+	#if QM_USE_SSE
+
+	result = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(v1.packed, v2.packed)));
+
+	#else
+
+	result = (v1.x < v2.x) | (v1.y < v2.y) << 1 | (v1.z < v2.z) << 2 | (v1.w < v2.w) << 3;
+
+	#endif
+
+	return result;
+}
+
+inline int mask_le(const ivec4& v1, const ivec4& v2)
+{
+	return ~mask_lt(v2, v1) & 0xF;
+}
+
+//selects v1 in lanes where the mask bit is set, and v2 elsewhere:
+inline ivec4 select(int mask, const ivec4& v1, const ivec4& v2)
+{
+	ivec4 result;
+
+	#if QM_USE_SSE
+
+	__m128i bits = _mm_and_si128(_mm_set1_epi32(mask), _mm_setr_epi32(1, 2, 4, 8));
+	__m128i m = _mm_cmpeq_epi32(bits, _mm_setr_epi32(1, 2, 4, 8));
+	result.packed = blend_epi32_sse(m, v1.packed, v2.packed);
+
+	#else
+
+	for(int i = 0; i < 4; i++)
+		result.v[i] = (mask >> i) & 1 ? v1.v[i] : v2.v[i];
+
+	#endif
+
+	return result;
+}
+
+//uvec4 arithmetic:
+
+inline uvec4 operator+(const uvec4& v1, const uvec4& v2)
+{
+	uvec4 result;
+
+	#if QM_USE_SSE
+
+	result.packed = _mm_add_epi32(v1.packed, v2.packed);
+
+	#else
+
+	for(int i = 0; i < 4; i++)
+		result.v[i] = v1.v[i] + v2.v[i];
+
+	#endif
+
+	return result;
+}
+
+inline uvec4 operator-(const uvec4& v1, const uvec4& v2)
+{
+	uvec4 result;
+
+	#if QM_USE_SSE
+
+	result.packed = _mm_sub_epi32(v1.packed, v2.packed);
+
+	#else
+
+	for(int i = 0; i < 4; i++)
+		result.v[i] = v1.v[i] - v2.v[i];
+
+	#endif
+
+	return result;
+}
+
+inline uvec4 operator*(const uvec4& v1, const uvec4& v2)
+{
+	uvec4 result;
+
+	#if QM_USE_SSE
+
+	result.packed = mullo_epi32_sse(v1.packed, v2.packed);
+
+	#else
+
+	for(int i = 0; i < 4; i++)
+		result.v[i] = v1.v[i] * v2.v[i];
+
+	#endif
+
+	return result;
+}
+
+inline uvec4 operator*(const uvec4& v, uint32_t s)
+{
+	return v * uvec4(s);
+}
+
+inline uvec4 operator*(uint32_t s, const uvec4& v)
+{
+	return uvec4(s) * v;
+}
+
+inline uvec4 operator&(const uvec4& v1, const uvec4& v2)
+{
+	uvec4 result;
+
+	#if QM_USE_SSE
+
+	result.packed = _mm_and_si128(v1.packed, v2.packed);
+
+	#else
+
+	for(int i = 0; i < 4; i++)
+		result.v[i] = v1.v[i] & v2.v[i];
+
+	#endif
+
+	return result;
+}
+
+inline uvec4 operator|(const uvec4& v1, const uvec4& v2)
+{
+	uvec4 result;
+
+	#if QM_USE_SSE
+
+	result.packed = _mm_or_si128(v1.packed, v2.packed);
+
+	#else
+
+	for(int i = 0; i < 4; i++)
+		result.v[i] = v1.v[i] | v2.v[i];
+
+	#endif
+
+	return result;
+}
+
+inline uvec4 operator^(const uvec4& v1, const uvec4& v2)
+{
+	uvec4 result;
+
+	#if QM_USE_SSE
+
+	result.packed = _mm_xor_si128(v1.packed, v2.packed);
+
+	#else
+
+	for(int i = 0; i < 4; i++)
+		result.v[i] = v1.v[i] ^ v2.v[i];
+
+	#endif
+
+	return result;
+}
+
+inline uvec4 operator<<(const uvec4& v, int s)
+{
+	uvec4 result;
+
+	#if QM_USE_SSE
+
+	result.packed = _mm_sll_epi32(v.packed, _mm_cvtsi32_si128(s));
+
+	#else
+
+	for(int i = 0; i < 4; i++)
+		result.v[i] = v.v[i] << s;
+
+	#endif
+
+	return result;
+}
+
+//logical shift, fills with zeros:
+inline uvec4 operator>>(const uvec4& v, int s)
+{
+	uvec4 result;
+
+	#if QM_USE_SSE
+
+	result.packed = _mm_srl_epi32(v.packed, _mm_cvtsi32_si128(s));
+
+	#else
+
+	for(int i = 0; i < 4; i++)
+		result.v[i] = v.v[i] >> s;
+
+	#endif
+
+	return result;
+}
+
+inline uvec4 min(const uvec4& v1, const uvec4& v2)
+{
+	uvec4 result;
+
+	#if QM_USE_SSE4_1
+
+	result.packed = _mm_min_epu32(v1.packed, v2.packed);
+
+	#elif QM_USE_SSE
+
+	__m128i less = _mm_cmplt_epi32(unsigned_bias_sse(v1.packed), unsigned_bias_sse(v2.packed));
+	result.packed = blend_epi32_sse(less, v1.packed, v2.packed);
+
+	#else
+
+	for(int i = 0; i < 4; i++)
+		result.v[i] = QM_MIN(v1.v[i], v2.v[i]);
+
+	#endif
+
+	return result;
+}
+
+inline uvec4 max(const uvec4& v1, const uvec4& v2)
+{
+	uvec4 result;
+
+	#if QM_USE_SSE4_1
+
+	result.packed = _mm_max_epu32(v1.packed, v2.packed);
+
+	#elif QM_USE_SSE
+
+	__m128i greater = _mm_cmpgt_epi32(unsigned_bias_sse(v1.packed), unsigned_bias_sse(v2.packed));
+	result.packed = blend_epi32_sse(greater, v1.packed, v2.packed);
+
+	#else
+
+	for(int i = 0; i < 4; i++)
+		result.v[i] = QM_MAX(v1.v[i], v2.v[i]);
+
+	#endif
+
+	return result;
+}
+
+//uvec4 comparisons:
+
+inline int mask_eq(const uvec4& v1, const uvec4& v2)
+{
+	int result;
+
+	#if QM_USE_SSE
+
+	result = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(v1.packed, v2.packed)));
+
+	#else
+
+	result = (v1.x == v2.x) | (v1.y == v2.y) << 1 | (v1.z == v2.z) << 2 | (v1.w == v2.w) << 3;
+
+	#endif
+
+	return result;
+}
+
+inline int mask_lt(const uvec4& v1, const uvec4& v2)
+{
+	int result;
+
+	#if QM_USE_SSE
+
+	__m128i less = _mm_cmplt_epi32(unsigned_bias_sse(v1.packed), unsigned_bias_sse(v2.packed));
+	result = _mm_movemask_ps(_mm_castsi128_ps(less));
+
+	#else
+
+	result = (v1.x < v2.x) | (v1.y < v2.y) << 1 | (v1.z < v2.z) << 2 | (v1.w < v2.w) << 3;
+
+	#endif
+
+	return result;
+}
+
+inline int mask_le(const uvec4& v1, const uvec4& v2)
+{
+	return ~mask_lt(v2, v1) & 0xF;
+}
+
+//conversions between float and integer vectors:
+
+//rounds towards negative infinity
+inline ivec4 ifloor(const vec4& v)
+{
+	ivec4 result;
+
+	#if QM_USE_SSE4_1
+
+	result.packed = _mm_cvttps_epi32(_mm_floor_ps(v.packed));
+
+	#elif QM_USE_SSE
+
+	//truncation rounds negative non-integers up, subtract 1 (add the all-ones mask) there:
+	__m128i truncated = _mm_cvttps_epi32(v.packed);
+	__m128 above = _mm_cmpgt_ps(_mm_cvtepi32_ps(truncated), v.packed);
+	result.packed = _mm_add_epi32(truncated, _mm_castps_si128(above));
+
+	#else
+
+	for(int i = 0; i < 4; i++)
+		result.v[i] = (int32_t)QM_FLOORF(v.v[i]);
+
+	#endif
+
+	return result;
+}
+
+//rounds to the nearest integer, with ties to even
+inline ivec4 iround(const vec4& v)
+{
+	ivec4 result;
+
+	#if QM_USE_SSE
+
+	result.packed = _mm_cvtps_epi32(v.packed); //assumes the default rounding mode
+
+	#else
+
+	for(int i = 0; i < 4; i++)
+		result.v[i] = (int32_t)QM_RINTF(v.v[i]);
+
+	#endif
+
+	return result;
+}
+
+//rounds towards zero
+inline ivec4 itrunc(const vec4& v)
+{
+	ivec4 result;
+
+	#if QM_USE_SSE
+
+	result.packed = _mm_cvttps_epi32(v.packed);
+
+	#else
+
+	for(int i = 0; i < 4; i++)
+		result.v[i] = (int32_t)v.v[i];
+
+	#endif
+
+	return result;
+}
+
+inline vec4 to_float(const ivec4& v)
+{
+	vec4 result;
+
+	#if QM_USE_SSE
+
+	result.packed = _mm_cvtepi32_ps(v.packed);
+
+	#else
+
+	for(int i = 0; i < 4; i++)
+		result.v[i] = (float)v.v[i];
+
+	#endif
+
+	return result;
+}
+
+inline ivec2 ifloor(const vec2& v)
+{
+	return ivec2((int32_t)QM_FLOORF(v.x), (int32_t)QM_FLOORF(v.y));
+}
+
+inline ivec3 ifloor(const vec3& v)
+{
+	return ivec3((int32_t)QM_FLOORF(v.x), (int32_t)QM_FLOORF(v.y), (int32_t)QM_FLOORF(v.z));
+}
+
+inline ivec2 iround(const vec2& v)
+{
+	return ivec2((int32_t)QM_RINTF(v.x), (int32_t)QM_RINTF(v.y));
+}
+
+inline ivec3 iround(const vec3& v)
+{
+	return ivec3((int32_t)QM_RINTF(v.x), (int32_t)QM_RINTF(v.y), (int32_t)QM_RINTF(v.z));
+}
+
+inline ivec2 itrunc(const vec2& v)
+{
+	return ivec2((int32_t)v.x, (int32_t)v.y);
+}
+
+inline ivec3 itrunc(const vec3& v)
+{
+	return ivec3((int32_t)v.x, (int32_t)v.y, (int32_t)v.z);
+}
+
+inline vec2 to_float(const ivec2& v)
+{
+	return vec2((float)v.x, (float)v.y);
+}
+
+inline vec3 to_float(const ivec3& v)
+{
+	return vec3((float)v.x, (float)v.y, (float)v.z);
+}
+
+//----------------------------------------------------------------------//
+//2D TRANSFORM FUNCTIONS:
+//mat2 is a 2x2 linear transform held in one SSE register, mat2x3 is an affine
+//2D transform with the translation in its last column (the top two rows of a mat3)
+
+inline mat2 mat2_identity()
+{
+	mat2 result;
+
+	result.m[0][0] = 1.0f;
+	result.m[1][1] = 1.0f;
+
+	return result;
+}
+
+inline mat2 operator+(const mat2& m1, const mat2& m2)
+{
+	mat2 result;
+
+	#if QM_USE_SSE
+
+	result.packed = _mm_add_ps(m1.packed, m2.packed);
+
+	#else
+
+	result.m[0][0] = m1.m[0][0] + m2.m[0][0];
+	result.m[0][1] = m1.m[0][1] + m2.m[0][1];
+	result.m[1][0] = m1.m[1][0] + m2.m[1][0];
+	result.m[1][1] = m1.m[1][1] + m2.m[1][1];
+
+	#endif
+
+	return result;
+}
+
+inline mat2 operator-(const mat2& m1, const mat2& m2)
+{
+	mat2 result;
+
+	#if QM_USE_SSE
+
+	result.packed = _mm_sub_ps(m1.packed, m2.packed);
+
+	#else
+
+	result.m[0][0] = m1.m[0][0] - m2.m[0][0];
+	result.m[0][1] = m1.m[0][1] - m2.m[0][1];
+	result.m[1][0] = m1.m[1][0] - m2.m[1][0];
+	result.m[1][1] = m1.m[1][1] - m2.m[1][1];
+
+	#endif
+
+	return result;
+}
+
+inline mat2 operator*(const mat2& m1, const mat2& m2)
+{
+	mat2 result;
+
+	#if QM_USE_SSE
+
+	//each result column is col0 * m2[i][0] + col1 * m2[i][1]:
+	__m128 col0 = _mm_shuffle_ps(m1.packed, m1.packed, _MM_SHUFFLE(1, 0, 1, 0));
+	__m128 col1 = _mm_shuffle_ps(m1.packed, m1.packed, _MM_SHUFFLE(3, 2, 3, 2));
+	__m128 x = _mm_shuffle_ps(m2.packed, m2.packed, _MM_SHUFFLE(2, 2, 0, 0));
+	__m128 y = _mm_shuffle_ps(m2.packed, m2.packed, _MM_SHUFFLE(3, 3, 1, 1));
+	result.packed = _mm_add_ps(_mm_mul_ps(col0, x), _mm_mul_ps(col1, y));
+
+	#else
+
+	result.m[0][0] = m1.m[0][0] * m2.m[0][0] + m1.m[1][0] * m2.m[0][1];
+	result.m[0][1] = m1.m[0][1] * m2.m[0][0] + m1.m[1][1] * m2.m[0][1];
+	result.m[1][0] = m1.m[0][0] * m2.m[1][0] + m1.m[1][0] * m2.m[1][1];
+	result.m[1][1] = m1.m[0][1] * m2.m[1][0] + m1.m[1][1] * m2.m[1][1];
+
+	#endif
+
+	return result;
+}
+
+inline vec2 operator*(const mat2& m, const vec2& v)
+{
+	vec2 result;
+
+	result.x = m.m[0][0] * v.x + m.m[1][0] * v.y;
+	result.y = m.m[0][1] * v.x + m.m[1][1] * v.y;
+
+	return result;
+}
+
+inline mat2 transpose(const mat2& m)
+{
+	mat2 result;
+
+	#if QM_USE_SSE
+
+	result.packed = _mm_shuffle_ps(m.packed, m.packed, _MM_SHUFFLE(3, 1, 2, 0));
+
+	#else
+
+	result.m[0][0] = m.m[0][0];
+	result.m[0][1] = m.m[1][0];
+	result.m[1][0] = m.m[0][1];
+	result.m[1][1] = m.m[1][1];
+
+	#endif
+
+	return result;
+}
+
+inline mat2 inverse(const mat2& m)
+{
+	mat2 result;
+
+	float det = m.m[0][0] * m.m[1][1] - m.m[1][0] * m.m[0][1];
+	float invDet = 1.0f / det;
+
+	#if QM_USE_SSE
+
+	__m128 adj = _mm_shuffle_ps(m.packed, m.packed, _MM_SHUFFLE(0, 2, 1, 3));
+	adj = _mm_xor_ps(adj, _mm_setr_ps(0.0f, -0.0f, -0.0f, 0.0f));
+	result.packed = _mm_mul_ps(adj, _mm_set1_ps(invDet));
+
+	#else
+
+	result.m[0][0] =  m.m[1][1] * invDet;
+	result.m[0][1] = -m.m[0][1] * invDet;
+	result.m[1][0] = -m.m[1][0] * invDet;
+	result.m[1][1] =  m.m[0][0] * invDet;
+
+	#endif
+
+	return result;
+}
+
+inline mat2 top_left(const mat3& m)
+{
+	mat2 result;
+
+	result.m[0][0] = m.m[0][0];
+	result.m[0][1] = m.m[0][1];
+	result.m[1][0] = m.m[1][0];
+	result.m[1][1] = m.m[1][1];
+
+	return result;
+}
+
+//affine 2D transforms:
+
+inline mat2x3 mat2x3_identity()
+{
+	mat2x3 result;
+
+	result.m[0][0] = 1.0f;
+	result.m[1][1] = 1.0f;
+
+	return result;
+}
+
+//equivalent to translate(t) * rotate(angle) * scale(s), the angle is in degrees
+inline mat2x3 compose(const vec2& t, float angle, const vec2& s)
+{
+	mat2x3 result;
+
+	float radians = deg_to_rad(angle);
+	float sine   = QM_SINF(radians);
+	float cosine = QM_COSF(radians);
+
+	result.m[0][0] =  cosine * s.x;
+	result.m[0][1] =   -sine * s.x;
+	result.m[1][0] =    sine * s.y;
+	result.m[1][1] =  cosine * s.y;
+	result.m[2][0] = t.x;
+	result.m[2][1] = t.y;
+
+	return result;
+}
+
+inline mat2x3 operator*(const mat2x3& m1, const mat2x3& m2)
+{
+	mat2x3 result;
+
+	for(int i = 0; i < 3; i++)
+	{
+		result.m[i][0] = m1.m[0][0] * m2.m[i][0] + m1.m[1][0] * m2.m[i][1];
+		result.m[i][1] = m1.m[0][1] * m2.m[i][0] + m1.m[1][1] * m2.m[i][1];
+	}
+
+	result.m[2][0] += m1.m[2][0];
+	result.m[2][1] += m1.m[2][1];
+
+	return result;
+}
+
+//transforms a point, applying the translation
+inline vec2 operator*(const mat2x3& m, const vec2& p)
+{
+	vec2 result;
+
+	result.x = m.m[0][0] * p.x + m.m[1][0] * p.y + m.m[2][0];
+	result.y = m.m[0][1] * p.x + m.m[1][1] * p.y + m.m[2][1];
+
+	return result;
+}
+
+inline mat2x3 inverse(const mat2x3& m)
+{
+	mat2x3 result;
+
+	float det = m.m[0][0] * m.m[1][1] - m.m[1][0] * m.m[0][1];
+	float invDet = 1.0f / det;
+
+	result.m[0][0] =  m.m[1][1] * invDet;
+	result.m[0][1] = -m.m[0][1] * invDet;
+	result.m[1][0] = -m.m[1][0] * invDet;
+	result.m[1][1] =  m.m[0][0] * invDet;
+	result.m[2][0] = -(result.m[0][0] * m.m[2][0] + result.m[1][0] * m.m[2][1]);
+	result.m[2][1] = -(result.m[0][1] * m.m[2][0] + result.m[1][1] * m.m[2][1]);
+
+	return result;
+}
+
+inline mat3 to_mat3(const mat2x3& m)
+{
+	mat3 result = mat3_identity();
+
+	for(int i = 0; i < 3; i++)
+	{
+		result.m[i][0] = m.m[i][0];
+		result.m[i][1] = m.m[i][1];
+	}
+
+	return result;
+}
+
+//transforms n points by m, 2 at a time in SIMD lanes
+inline void transform_points(const mat2x3& m, const vec2* points, size_t n, vec2* out)
+{
+	size_t i = 0;
+
+	#if QM_USE_SSE
+
+	//lanes hold [x0, y0, x1, y1], each column is repeated for both points:
+	__m128 col0 = _mm_setr_ps(m.m[0][0], m.m[0][1], m.m[0][0], m.m[0][1]);
+	__m128 col1 = _mm_setr_ps(m.m[1][0], m.m[1][1], m.m[1][0], m.m[1][1]);
+	__m128 col2 = _mm_setr_ps(m.m[2][0], m.m[2][1], m.m[2][0], m.m[2][1]);
+
+	for(; i + 2 <= n; i += 2)
+	{
+		__m128 p = _mm_loadu_ps(points[i].v);
+		__m128 x = _mm_shuffle_ps(p, p, _MM_SHUFFLE(2, 2, 0, 0));
+		__m128 y = _mm_shuffle_ps(p, p, _MM_SHUFFLE(3, 3, 1, 1));
+
+		__m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, col0), _mm_mul_ps(y, col1)), col2);
+		_mm_storeu_ps(out[i].v, r);
+	}
+
+	#endif
+
+	for(; i < n; i++)
+		out[i] = m * points[i];
+}
+
+//writes the 4 corners of n sprites to out (4 * n entries), each a size-by-size quad centered on its
+//position, scaled and then rotated by its angle in degrees (as in compose()), 4 sprites at a time in SIMD lanes
+//the corners are ordered (-x, -y), (+x, -y), (+x, +y), (-x, +y) in the sprite's local space
+inline void sprite_corners(const vec2* positions, const float* angles, const vec2* scales, const vec2* sizes, size_t n, vec2* out)
+{
+	size_t i = 0;
+
+	#if QM_USE_SSE
+
+	for(; i + 4 <= n; i += 4)
+	{
+		//deinterleave 4 vec2s into x and y lanes:
+		__m128 p0 = _mm_loadu_ps(positions[i].v);
+		__m128 p1 = _mm_loadu_ps(positions[i + 2].v);
+		__m128 s0 = _mm_mul_ps(_mm_loadu_ps(scales[i].v    ), _mm_loadu_ps(sizes[i].v    ));
+		__m128 s1 = _mm_mul_ps(_mm_loadu_ps(scales[i + 2].v), _mm_loadu_ps(sizes[i + 2].v));
+
+		__m128 px = _mm_shuffle_ps(p0, p1, _MM_SHUFFLE(2, 0, 2, 0));
+		__m128 py = _mm_shuffle_ps(p0, p1, _MM_SHUFFLE(3, 1, 3, 1));
+		__m128 hx = _mm_mul_ps(_mm_shuffle_ps(s0, s1, _MM_SHUFFLE(2, 0, 2, 0)), _mm_set1_ps(0.5f));
+		__m128 hy = _mm_mul_ps(_mm_shuffle_ps(s0, s1, _MM_SHUFFLE(3, 1, 3, 1)), _mm_set1_ps(0.5f));
+
+		__m128 sine, cosine;
+		sincos_sse(_mm_mul_ps(_mm_loadu_ps(angles + i), _mm_set1_ps(0.01745329251f)), &sine, &cosine);
+
+		//half-extent vectors along the rotated local axes:
+		__m128 ax = _mm_mul_ps(cosine, hx);
+		__m128 ay = _mm_xor_ps(_mm_mul_ps(sine, hx), _mm_set1_ps(-0.0f));
+		__m128 bx = _mm_mul_ps(sine, hy);
+		__m128 by = _mm_mul_ps(cosine, hy);
+
+		__m128 x0 = _mm_sub_ps(_mm_sub_ps(px, ax), bx);
+		__m128 y0 = _mm_sub_ps(_mm_sub_ps(py, ay), by);
+		__m128 x1 = _mm_sub_ps(_mm_add_ps(px, ax), bx);
+		__m128 y1 = _mm_sub_ps(_mm_add_ps(py, ay), by);
+		__m128 x2 = _mm_add_ps(_mm_add_ps(px, ax), bx);
+		__m128 y2 = _mm_add_ps(_mm_add_ps(py, ay), by);
+		__m128 x3 = _mm_add_ps(_mm_sub_ps(px, ax), bx);
+		__m128 y3 = _mm_add_ps(_mm_sub_ps(py, ay), by);
+
+		//interleave back into 4 corners per sprite:
+		__m128 lo0 = _mm_unpacklo_ps(x0, y0);
+		__m128 hi0 = _mm_unpackhi_ps(x0, y0);
+		__m128 lo1 = _mm_unpacklo_ps(x1, y1);
+		__m128 hi1 = _mm_unpackhi_ps(x1, y1);
+		__m128 lo2 = _mm_unpacklo_ps(x2, y2);
+		__m128 hi2 = _mm_unpackhi_ps(x2, y2);
+		__m128 lo3 = _mm_unpacklo_ps(x3, y3);
+		__m128 hi3 = _mm_unpackhi_ps(x3, y3);
+
+		float* dst = out[i * 4].v;
+		_mm_storeu_ps(dst     , _mm_movelh_ps(lo0, lo1));
+		_mm_storeu_ps(dst +  4, _mm_movelh_ps(lo2, lo3));
+		_mm_storeu_ps(dst +  8, _mm_movehl_ps(lo1, lo0));
+		_mm_storeu_ps(dst + 12, _mm_movehl_ps(lo3, lo2));
+		_mm_storeu_ps(dst + 16, _mm_movelh_ps(hi0, hi1));
+		_mm_storeu_ps(dst + 20, _mm_movelh_ps(hi2, hi3));
+		_mm_storeu_ps(dst + 24, _mm_movehl_ps(hi1, hi0));
+		_mm_storeu_ps(dst + 28, _mm_movehl_ps(hi3, hi2));
+	}
+
+	#endif
+
+	for(; i < n; i++)
+	{
+		float radians = deg_to_rad(angles[i]);
+		float sine   = QM_SINF(radians);
+		float cosine = QM_COSF(radians);
+
+		vec2 half = scales[i] * sizes[i] * 0.5f;
+		vec2 a = vec2(cosine * half.x, -sine * half.x);
+		vec2 b = vec2(sine * half.y, cosine * half.y);
+
+		out[i * 4    ] = positions[i] - a - b;
+		out[i * 4 + 1] = positions[i] + a - b;
+		out[i * 4 + 2] = positions[i] + a + b;
+		out[i * 4 + 3] = positions[i] - a + b;
+	}
+}
+
 }; //namespace qm
 
 #endif //QM_MATH_H
\ No newline at end of file